@@ -554,6 +554,11 @@ DEF_AVTP_ACCESSER_UINT32(crf_base_frequency, 12)
 DEF_AVTP_ACCESSER_UINT16(crf_data_length, 16)
 DEF_AVTP_ACCESSER_UINT16(crf_timestamp_interval, 18)
 
+/* timestamps of a CRF AVTPDU filling the MTU */
+#define AVTP_CRF_TIMESTAMPS_MAX \
+	((ETHFRAMEMTU_MAX - (AVTP_CRF_PAYLOAD_OFFSET - AVTP_OFFSET)) / \
+	 sizeof(u64))
+
 /**
  * Template - IEEE1722
  */
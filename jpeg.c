@@ -94,19 +94,18 @@ const u32 *quantizer[] = {
 	jpeg_chroma_quantizer,
 };
 
-static u8 lum_dc_codelens[] = {
-	0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0,
-};
-
-static u8 lum_dc_symbols[] = {
-	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
-};
-
-static u8 lum_ac_codelens[] = {
-	0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d,
-};
-
-static u8 lum_ac_symbols[] = {
+/* Huffman tables (DHT segments) of RFC 2435 Appendix A, in wire format */
+static const u8 jpeg_dht[] = {
+	/* Luminance DC */
+	JPEG_MARKER, JPEG_MARKER_KIND_DHT, 0x00, 0x1f, 0x00,
+	0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b,
+	/* Luminance AC */
+	JPEG_MARKER, JPEG_MARKER_KIND_DHT, 0x00, 0xb5, 0x10,
+	0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03,
+	0x05, 0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7d,
 	0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12,
 	0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
 	0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
@@ -128,21 +127,16 @@ static u8 lum_ac_symbols[] = {
 	0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
 	0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
 	0xf9, 0xfa,
-};
-
-static u8 chm_dc_codelens[] = {
-	0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
-};
-
-static u8 chm_dc_symbols[] = {
-	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
-};
-
-static u8 chm_ac_codelens[] = {
-	0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77,
-};
-
-static u8 chm_ac_symbols[] = {
+	/* Chrominance DC */
+	JPEG_MARKER, JPEG_MARKER_KIND_DHT, 0x00, 0x1f, 0x01,
+	0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b,
+	/* Chrominance AC */
+	JPEG_MARKER, JPEG_MARKER_KIND_DHT, 0x00, 0xb5, 0x11,
+	0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04,
+	0x07, 0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77,
 	0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21,
 	0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
 	0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
@@ -423,47 +417,6 @@ static u8 *jpeg_make_dqt(u8 *p, u8 *qt, u32 id, u8 q, u32 len)
 	return p;
 }
 
-static u8 *jpeg_make_dht(u8 *p, u32 i)
-{
-	struct {
-		u8 class;
-		u8 id;
-		u8 *codelens;
-		u8 ncodes;
-		u8 *symbols;
-		u8 nsymbols;
-	} htable[] = {
-		{
-			0, 0, lum_dc_codelens, ARRAY_SIZE(lum_dc_codelens),
-			lum_dc_symbols, ARRAY_SIZE(lum_dc_symbols),
-		},
-		{
-			1, 0, lum_ac_codelens, ARRAY_SIZE(lum_ac_codelens),
-			lum_ac_symbols, ARRAY_SIZE(lum_ac_symbols),
-		},
-		{
-			0, 1, chm_dc_codelens, ARRAY_SIZE(chm_dc_codelens),
-			chm_dc_symbols, ARRAY_SIZE(chm_dc_symbols),
-		},
-		{
-			1, 1, chm_ac_codelens, ARRAY_SIZE(chm_ac_codelens),
-			chm_ac_symbols, ARRAY_SIZE(chm_ac_symbols),
-		},
-	};
-
-	*p++ = JPEG_MARKER;
-	*p++ = JPEG_MARKER_KIND_DHT;	/* DHT */
-	*p++ = 0;					  /* length msb */
-	*p++ = 3 + htable[i].ncodes + htable[i].nsymbols; /* length lsb */
-	*p++ = (htable[i].class << 4) | htable[i].id;
-	memcpy(p, htable[i].codelens, htable[i].ncodes);
-	p += htable[i].ncodes;
-	memcpy(p, htable[i].symbols, htable[i].nsymbols);
-	p += htable[i].nsymbols;
-
-	return p;
-}
-
 static u8 *jpeg_make_dri(u8 *p, u16 dri)
 {
 	*p++ = JPEG_MARKER;
@@ -556,8 +509,8 @@ u32 jpeg_make_header(enum MJPEG_TYPE type,
 	*p++ = JPEG_SOF_COMP_SAMPLE_1X1;	/* hsamp = 1, vsamp = 1 */
 	*p++ = 1;				/* quant table 1 */
 
-	for (i = 0; i < JPEG_DHT_TABLE_NUM; i++)
-		p = jpeg_make_dht(p, i);
+	memcpy(p, jpeg_dht, sizeof(jpeg_dht));
+	p += sizeof(jpeg_dht);
 
 	*p++ = JPEG_MARKER;
 	*p++ = JPEG_MARKER_KIND_SOS;
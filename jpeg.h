@@ -78,7 +78,6 @@
 #define JPEG_SOF_COMP_SAMPLE_2X1  (0x02 << 4 | 0x01)
 #define JPEG_SOF_COMP_SAMPLE_2X2  (0x02 << 4 | 0x02)
 #define JPEG_SOF_COMP_SAMPLE_1X1  (0x01 << 4 | 0x01)
-#define JPEG_DHT_TABLE_NUM        (4)
 #define JPEG_SOS_ID_LEN           (12)
 #define JPEG_DQT_ID_LEN           (1)
 #define JPEG_DQT_QUANT_SIZE8      (64)
@@ -88,6 +87,9 @@
 #define JPEG_DRI_L_DEFAULT        (0x40)
 #define JPEG_DRI_RCOUNT_DEFAULT   (0x3FFF)
 
+/* SOI + JFIF, 4 x 16-bit DQT, DRI, SOF0, 4 x DHT and SOS */
+#define JPEG_HEADER_SIZE_MAX      (1024)
+
 #define JPEG_GET_DQT_PREC(__data) (((__data) & 0xF0) >> 4)
 #define JPEG_GET_DQT_QID(__data)  ((__data) & 0x0F)
 #define JPEG_SET_DQT_ID(__prec, __qid) \
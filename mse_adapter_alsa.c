@@ -79,11 +79,28 @@
 #define ALSA_PCM_DEVICE_MAX		(8)
 #define MSE_ADAPTER_ALSA_DEVICE_MAX	(ALSA_PCM_DEVICE_MAX)
 #define MSE_ADAPTER_ALSA_DEVICE_DEFAULT	(2)
-#define MSE_ADAPTER_ALSA_PAGE_SIZE	(64 * 1024)
+
+/* hw limits, derived from max stream configuration */
+#define MSE_ADAPTER_ALSA_RATE_MAX		(192000)
+#define MSE_ADAPTER_ALSA_CHANNELS_MAX		(24)
+#define MSE_ADAPTER_ALSA_SAMPLE_BYTES_MAX	(4)
+#define MSE_ADAPTER_ALSA_PERIOD_TIME_MAX_MS	(10)
+#define MSE_ADAPTER_ALSA_PERIODS_MAX		(32)
+#define MSE_ADAPTER_ALSA_PERIOD_BYTES_MAX \
+	(MSE_ADAPTER_ALSA_CHANNELS_MAX * MSE_ADAPTER_ALSA_SAMPLE_BYTES_MAX * \
+	 (MSE_ADAPTER_ALSA_RATE_MAX / 1000) * \
+	 MSE_ADAPTER_ALSA_PERIOD_TIME_MAX_MS)
+#define MSE_ADAPTER_ALSA_BUFFER_BYTES_MAX \
+	(MSE_ADAPTER_ALSA_PERIOD_BYTES_MAX * 8)
 
 static int alsa_devices = MSE_ADAPTER_ALSA_DEVICE_DEFAULT;
 module_param(alsa_devices, int, 0440);
 
+static int alsa_period_batch = 1;
+module_param(alsa_period_batch, int, 0440);
+MODULE_PARM_DESC(alsa_period_batch,
+		 "Periods submitted to MSE core at once (1-8)");
+
 /*************/
 /* Structure */
 /*************/
@@ -95,6 +112,9 @@ struct alsa_stream {
 	int				period_pos;
 	int				byte_per_period;
 	int				next_period_byte;
+	int				submit_period;
+	int				period_batch;
+	int				in_flight;
 	int				index;
 	bool				streaming;
 };
@@ -134,14 +154,14 @@ struct snd_pcm_hardware g_mse_adapter_alsa_playback_hw = {
 				  SNDRV_PCM_FMTBIT_S24_3BE,
 	.rates			= SNDRV_PCM_RATE_8000_192000,
 	.rate_min		= 8000,
-	.rate_max		= 192000,
+	.rate_max		= MSE_ADAPTER_ALSA_RATE_MAX,
 	.channels_min		= 1,
-	.channels_max		= 24,
-	.buffer_bytes_max	= 65536,
+	.channels_max		= MSE_ADAPTER_ALSA_CHANNELS_MAX,
+	.buffer_bytes_max	= MSE_ADAPTER_ALSA_BUFFER_BYTES_MAX,
 	.period_bytes_min	= 64,
-	.period_bytes_max	= 8192,
+	.period_bytes_max	= MSE_ADAPTER_ALSA_PERIOD_BYTES_MAX,
 	.periods_min		= 2,
-	.periods_max		= 32,
+	.periods_max		= MSE_ADAPTER_ALSA_PERIODS_MAX,
 };
 
 /* hw - Capture */
@@ -164,19 +184,48 @@ struct snd_pcm_hardware g_mse_adapter_alsa_capture_hw = {
 				  SNDRV_PCM_FMTBIT_S24_3BE,
 	.rates			= SNDRV_PCM_RATE_8000_192000,
 	.rate_min		= 8000,
-	.rate_max		= 192000,
+	.rate_max		= MSE_ADAPTER_ALSA_RATE_MAX,
 	.channels_min		= 1,
-	.channels_max		= 24,
-	.buffer_bytes_max	= 65536,
+	.channels_max		= MSE_ADAPTER_ALSA_CHANNELS_MAX,
+	.buffer_bytes_max	= MSE_ADAPTER_ALSA_BUFFER_BYTES_MAX,
 	.period_bytes_min	= 64,
-	.period_bytes_max	= 8192,
+	.period_bytes_max	= MSE_ADAPTER_ALSA_PERIOD_BYTES_MAX,
 	.periods_min		= 2,
-	.periods_max		= 32,
+	.periods_max		= MSE_ADAPTER_ALSA_PERIODS_MAX,
 };
 
 /************/
 /* Function */
 /************/
+static int mse_adapter_alsa_callback(void *priv, int size);
+
+static int mse_adapter_alsa_submit(struct alsa_stream *io)
+{
+	struct snd_pcm_runtime *runtime = io->substream->runtime;
+	int periods;
+	int err;
+
+	/* contiguous periods until end of DMA area */
+	periods = min_t(int, io->period_batch,
+			runtime->periods - io->submit_period);
+
+	err = mse_start_transmission_periods(
+			io->index,
+			runtime->dma_area +
+			io->submit_period * io->byte_per_period,
+			io->byte_per_period,
+			periods,
+			io,
+			mse_adapter_alsa_callback);
+	if (err < 0)
+		return err;
+
+	io->in_flight += periods;
+	io->submit_period = (io->submit_period + periods) % runtime->periods;
+
+	return 0;
+}
+
 static int mse_adapter_alsa_callback(void *priv, int size)
 {
 	struct snd_pcm_runtime *runtime;
@@ -221,11 +270,11 @@ static int mse_adapter_alsa_callback(void *priv, int size)
 		return 0;
 	}
 
-	err = mse_start_transmission(io->index,
-				     runtime->dma_area + io->byte_pos,
-				     io->byte_per_period,
-				     io,
-				     mse_adapter_alsa_callback);
+	/* submit next periods, when all submitted periods completed */
+	if (--io->in_flight > 0)
+		return 0;
+
+	err = mse_adapter_alsa_submit(io);
 	if (err < 0) {
 		mse_err("Failed mse_start_transmission() err=%d\n", err);
 		return -EPERM;
@@ -392,6 +441,12 @@ static int mse_adapter_alsa_trigger(
 					  * runtime->channels
 					  * samples_to_bytes(runtime, 1);
 		io->next_period_byte	= io->byte_per_period;
+		io->submit_period	= 0;
+		io->in_flight		= 0;
+		io->period_batch	= clamp_t(int, alsa_period_batch, 1,
+						  MSE_TRANS_PERIODS_MAX);
+		if (io->period_batch >= runtime->periods)
+			io->period_batch = runtime->periods - 1;
 
 		/* config check */
 		mse_debug("ch=%u period_size=%lu fmt_size=%zu\n",
@@ -405,11 +460,7 @@ static int mse_adapter_alsa_trigger(
 			break;
 		}
 		io->streaming = true;
-		err = mse_start_transmission(io->index,
-					     runtime->dma_area + io->byte_pos,
-					     io->byte_per_period,
-					     io,
-					     mse_adapter_alsa_callback);
+		err = mse_adapter_alsa_submit(io);
 		if (err < 0) {
 			mse_err("Failed mse_start_transmission() err=%d\n",
 				err);
@@ -449,14 +500,14 @@ static int mse_adapter_alsa_hw_params(struct snd_pcm_substream *substream,
 				      struct snd_pcm_hw_params *hw_params)
 {
 	mse_debug("START\n");
-	return snd_pcm_lib_malloc_pages(substream,
-					params_buffer_bytes(hw_params));
+	return snd_pcm_lib_alloc_vmalloc_buffer(substream,
+						params_buffer_bytes(hw_params));
 }
 
 static int mse_adapter_alsa_hw_free(struct snd_pcm_substream *substream)
 {
 	mse_debug("START\n");
-	return snd_pcm_lib_free_pages(substream);
+	return snd_pcm_lib_free_vmalloc_buffer(substream);
 }
 
 static enum MSE_AUDIO_BIT get_alsa_bit_depth(int alsa_format)
@@ -571,6 +622,7 @@ struct snd_pcm_ops g_mse_adapter_alsa_playback_ops = {
 	.prepare	= mse_adapter_alsa_prepare,
 	.trigger	= mse_adapter_alsa_trigger,
 	.pointer	= mse_adapter_alsa_pointer,
+	.page		= snd_pcm_lib_get_vmalloc_page,
 };
 
 struct snd_pcm_ops g_mse_adapter_alsa_capture_ops = {
@@ -582,6 +634,7 @@ struct snd_pcm_ops g_mse_adapter_alsa_capture_ops = {
 	.prepare	= mse_adapter_alsa_prepare,
 	.trigger	= mse_adapter_alsa_trigger,
 	.pointer	= mse_adapter_alsa_pointer,
+	.page		= snd_pcm_lib_get_vmalloc_page,
 };
 
 /* Global variable */
@@ -665,18 +718,7 @@ static int mse_adapter_alsa_probe(struct snd_card *card, int devno)
 			SNDRV_PCM_STREAM_CAPTURE,
 			&g_mse_adapter_alsa_capture_ops);
 
-	/* pre-allocation of buffers */
-	err = snd_pcm_lib_preallocate_pages_for_all(
-					pcm,
-					SNDRV_DMA_TYPE_CONTINUOUS,
-					snd_dma_continuous_data(GFP_KERNEL),
-					MSE_ADAPTER_ALSA_PAGE_SIZE,
-					MSE_ADAPTER_ALSA_PAGE_SIZE);
-	if (err < 0) {
-		mse_err("Failed pre-allocation err=%d\n", err);
-		mse_unregister_adapter_media(index);
-		return -EPERM;
-	}
+	/* buffers are allocated by vmalloc at hw_params */
 
 	/* allocate a chip-specific data with zero filled */
 	chip = kzalloc(sizeof(*chip), GFP_KERNEL);
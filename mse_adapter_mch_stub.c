@@ -0,0 +1,309 @@
+/*************************************************************************/ /*
+ avb-mse
+
+ Copyright (C) 2016-2017 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#undef pr_fmt
+#define pr_fmt(fmt) KBUILD_MODNAME "/" fmt
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+
+#include "ravb_mse_kernel.h"
+
+/*
+ * Reference MCH implementation for evaluating media clock recovery
+ * without MCH hardware. It records master/device timestamp pairs,
+ * estimates frequency error for every window and feeds back the
+ * recovery value with a simple integral loop.
+ */
+
+#define MCH_STUB_RECORD_MAX		(4096)
+#define MCH_STUB_WINDOW_DEFAULT		(64)
+#define MCH_STUB_LOCK_PPB_DEFAULT	(1000)
+#define MCH_STUB_LOCK_COUNT		(3)
+#define MCH_STUB_GAIN_SHIFT		(1)
+
+static int mch_stub_window = MCH_STUB_WINDOW_DEFAULT;
+module_param(mch_stub_window, int, 0440);
+MODULE_PARM_DESC(mch_stub_window, "Timestamp pairs per estimation window");
+
+static int mch_stub_lock_ppb = MCH_STUB_LOCK_PPB_DEFAULT;
+module_param(mch_stub_lock_ppb, int, 0644);
+MODULE_PARM_DESC(mch_stub_lock_ppb, "Frequency error to regard as locked");
+
+static bool mch_stub_dump;
+module_param(mch_stub_dump, bool, 0644);
+MODULE_PARM_DESC(mch_stub_dump, "Dump recorded timestamp pairs at close");
+
+struct mch_stub {
+	u32 interval;
+	u64 open_time;
+
+	/* recorded timestamp pairs */
+	struct mch_timestamp record[MCH_STUB_RECORD_MAX];
+	int record_pos;
+	u64 record_total;
+
+	/* estimation window */
+	struct mch_timestamp window_start;
+	int window_count;
+
+	/* recovery loop */
+	int recovery_value;
+	int lock_count;
+	bool f_locked;
+	u64 lock_time;
+
+	/* steady state error after lock */
+	u64 steady_windows;
+	u64 steady_error_total;
+	s64 steady_error_max;
+};
+
+static void *mch_stub_open(void)
+{
+	struct mch_stub *stub;
+
+	stub = vzalloc(sizeof(*stub));
+	if (!stub)
+		return NULL;
+
+	stub->open_time = ktime_get_ns();
+
+	mse_debug("mch_handle=%p\n", stub);
+
+	return stub;
+}
+
+/* print recorded pairs, oldest first, for offline evaluation */
+static void mch_stub_dump_record(struct mch_stub *stub)
+{
+	struct mch_timestamp *ts;
+	int num, pos, i;
+
+	num = min_t(u64, stub->record_total, MCH_STUB_RECORD_MAX);
+	pos = (stub->record_pos + MCH_STUB_RECORD_MAX - num) %
+	      MCH_STUB_RECORD_MAX;
+
+	for (i = 0; i < num; i++) {
+		ts = &stub->record[(pos + i) % MCH_STUB_RECORD_MAX];
+		mse_info("pair %d master=%llu device=%llu\n",
+			 i, (u64)ts->master, (u64)ts->device);
+	}
+}
+
+static int mch_stub_close(void *mch)
+{
+	struct mch_stub *stub = mch;
+
+	if (!stub)
+		return -EINVAL;
+
+	if (mch_stub_dump)
+		mch_stub_dump_record(stub);
+
+	mse_info("pairs=%llu lock=%s time=%llums recovery=%dppb\n",
+		 stub->record_total, stub->f_locked ? "yes" : "no",
+		 div_u64(stub->lock_time, NSEC_PER_MSEC),
+		 stub->recovery_value);
+
+	if (stub->steady_windows)
+		mse_info("steady error avg=%lluppb max=%lldppb windows=%llu\n",
+			 div64_u64(stub->steady_error_total,
+				   stub->steady_windows),
+			 stub->steady_error_max, stub->steady_windows);
+
+	vfree(stub);
+
+	return 0;
+}
+
+static int mch_stub_set_interval(void *mch, u32 ns)
+{
+	struct mch_stub *stub = mch;
+
+	if (!stub)
+		return -EINVAL;
+
+	stub->interval = ns;
+
+	return 0;
+}
+
+static void mch_stub_update(struct mch_stub *stub,
+			    struct mch_timestamp *ts)
+{
+	s32 master_diff, device_diff;
+	s64 error;
+
+	master_diff = (s32)((u32)ts->master - (u32)stub->window_start.master);
+	device_diff = (s32)((u32)ts->device - (u32)stub->window_start.device);
+	if (device_diff <= 0)
+		return;
+
+	/* frequency error of device clock against master in ppb */
+	error = div_s64((s64)(master_diff - device_diff) * NSEC_PER_SEC,
+			device_diff);
+
+	stub->recovery_value += (int)(error >> MCH_STUB_GAIN_SHIFT);
+
+	if (stub->f_locked) {
+		stub->steady_windows++;
+		stub->steady_error_total += abs(error);
+		if (abs(error) > stub->steady_error_max)
+			stub->steady_error_max = abs(error);
+	} else if (abs(error) < mch_stub_lock_ppb) {
+		if (++stub->lock_count >= MCH_STUB_LOCK_COUNT) {
+			stub->f_locked = true;
+			stub->lock_time = ktime_get_ns() - stub->open_time;
+		}
+	} else {
+		stub->lock_count = 0;
+	}
+}
+
+static int mch_stub_send_timestamps(void *mch,
+				    struct mch_timestamp *ts,
+				    int count)
+{
+	struct mch_stub *stub = mch;
+	int i;
+
+	if (!stub || !ts)
+		return -EINVAL;
+
+	for (i = 0; i < count; i++) {
+		stub->record[stub->record_pos] = ts[i];
+		stub->record_pos = (stub->record_pos + 1) % MCH_STUB_RECORD_MAX;
+		stub->record_total++;
+
+		if (!stub->window_count++) {
+			stub->window_start = ts[i];
+			continue;
+		}
+
+		if (stub->window_count > mch_stub_window) {
+			mch_stub_update(stub, &ts[i]);
+			stub->window_start = ts[i];
+			stub->window_count = 1;
+		}
+	}
+
+	return 0;
+}
+
+static int mch_stub_get_recovery_value(void *mch, int *value)
+{
+	struct mch_stub *stub = mch;
+
+	if (!stub || !value)
+		return -EINVAL;
+
+	*value = stub->recovery_value;
+
+	return 0;
+}
+
+static struct mch_ops mch_stub_mse_ops = {
+	.open = mch_stub_open,
+	.close = mch_stub_close,
+	.set_interval = mch_stub_set_interval,
+	.send_timestamps = mch_stub_send_timestamps,
+	.get_recovery_value = mch_stub_get_recovery_value,
+};
+
+static int mch_stub_mse_if_instance_id;
+
+static int __init mse_adapter_mch_stub_init(void)
+{
+	int inst_id;
+
+	mse_debug("START\n");
+
+	if (mch_stub_window <= 0) {
+		mse_err("Invalid window %d\n", mch_stub_window);
+		return -EINVAL;
+	}
+
+	inst_id = mse_register_mch(&mch_stub_mse_ops);
+	if (inst_id < 0)
+		return inst_id;
+
+	mch_stub_mse_if_instance_id = inst_id;
+
+	return 0;
+}
+
+static void __exit mse_adapter_mch_stub_exit(void)
+{
+	mse_debug("START\n");
+	mse_unregister_mch(mch_stub_mse_if_instance_id);
+}
+
+module_init(mse_adapter_mch_stub_init);
+module_exit(mse_adapter_mch_stub_exit);
+
+MODULE_AUTHOR("Renesas Electronics Corporation");
+MODULE_DESCRIPTION("Renesas Media Streaming Engine");
+MODULE_LICENSE("Dual MIT/GPL");
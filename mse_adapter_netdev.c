@@ -0,0 +1,936 @@
+/*************************************************************************/ /*
+ avb-mse
+
+ Copyright (C) 2015-2017 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#undef pr_fmt
+#define pr_fmt(fmt) KBUILD_MODNAME "/" fmt
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/kernel.h>
+#include <linux/version.h>
+#include <linux/netdevice.h>
+#include <linux/etherdevice.h>
+#include <linux/ethtool.h>
+#include <linux/if_vlan.h>
+#include <linux/skbuff.h>
+#include <linux/wait.h>
+#include <linux/rtnetlink.h>
+#include <linux/hashtable.h>
+#include <linux/rculist.h>
+#include <asm/unaligned.h>
+#if KERNEL_VERSION(4, 15, 0) <= LINUX_VERSION_CODE
+#include <net/pkt_sched.h>
+#endif
+#include "ravb_mse_kernel.h"
+#include "avtp.h"
+
+#define MSE_NETDEV_ADAPTER_MAX (MSE_INSTANCE_MAX)
+
+/* network devices with listeners, stream ID hash buckets per device */
+#define MSE_NETDEV_DEMUX_MAX (8)
+#define MSE_NETDEV_DEMUX_HASH_BITS (5)
+
+#define MSE_NETDEV_ADAPTER_PACKET_MAX (1024)
+#define MSE_NETDEV_ADAPTER_ENTRY_MAX (128)
+
+/* frames held per receive queue before dropping */
+#define MSE_NETDEV_RX_QUEUE_MAX (256)
+
+#define MSE_NETDEV_PACKET_LENGTH (1526)
+
+/* end of stream_id in the AVTP header */
+#define MSE_NETDEV_STREAMID_END (4 + AVTP_STREAMID_SIZE)
+
+/* fallback when the driver does not report a link speed */
+#define MSE_NETDEV_LINK_SPEED_DEFAULT (1000)
+
+/* one receive handler per device, dispatching frames by stream ID */
+struct mse_netdev_demux {
+	struct net_device *ndev;
+	int users;
+	struct packet_type ptype;
+	/* writers of streams and any, readers use RCU */
+	spinlock_t lock;
+	DECLARE_HASHTABLE(streams, MSE_NETDEV_DEMUX_HASH_BITS);
+	/* listeners without stream ID */
+	struct hlist_head any;
+};
+
+struct mse_adapter_netdev {
+	int index;
+	struct net_device *ndev;
+	bool f_tx;
+	struct mse_packet *packets;
+	int num_entry;
+	int unentry;
+
+	/* receive */
+	struct mse_netdev_demux *demux;
+	struct hlist_node node;
+	bool f_linked;
+	u64 key;
+	struct sk_buff_head rxq;
+	wait_queue_head_t wait_rx;
+	bool f_cancel;
+	bool f_streamid;
+
+	/* transmit */
+	bool f_cbs_offload;
+	bool f_launch_time;
+};
+
+static int adapter_index;
+static struct mse_adapter_netdev netdev_table[MSE_NETDEV_ADAPTER_MAX];
+static DECLARE_BITMAP(netdev_table_map, MSE_NETDEV_ADAPTER_MAX);
+static DEFINE_SPINLOCK(netdev_table_lock);
+
+static struct mse_netdev_demux demux_table[MSE_NETDEV_DEMUX_MAX];
+static DEFINE_MUTEX(demux_mutex);
+
+/* tx queue for CBS offload, negative leaves shaping to the qdisc */
+static int netdev_cbs_queue = -1;
+module_param(netdev_cbs_queue, int, 0440);
+MODULE_PARM_DESC(netdev_cbs_queue,
+		 "TX queue for CBS offload (-1: use configured qdisc)");
+
+static struct mse_adapter_netdev *mse_adapter_netdev_alloc_priv(
+	struct net_device *ndev)
+{
+	int index;
+	struct mse_adapter_netdev *netdev = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&netdev_table_lock, flags);
+
+	index = find_first_zero_bit(netdev_table_map, MSE_NETDEV_ADAPTER_MAX);
+	if (index < MSE_NETDEV_ADAPTER_MAX) {
+		/* found free slot */
+		netdev = &netdev_table[index];
+		netdev->index = index;
+		netdev->ndev = ndev;
+		set_bit(index, netdev_table_map);
+	}
+
+	spin_unlock_irqrestore(&netdev_table_lock, flags);
+
+	return netdev;
+}
+
+static void mse_adapter_netdev_free_priv(int index)
+{
+	struct mse_adapter_netdev *netdev;
+	unsigned long flags;
+
+	spin_lock_irqsave(&netdev_table_lock, flags);
+
+	if (test_and_clear_bit(index, netdev_table_map)) {
+		netdev = &netdev_table[index];
+		memset(netdev, 0, sizeof(*netdev));
+	}
+
+	spin_unlock_irqrestore(&netdev_table_lock, flags);
+}
+
+static struct mse_adapter_netdev *mse_adapter_netdev_get_priv(int index)
+{
+	struct mse_adapter_netdev *netdev = NULL;
+	unsigned long flags;
+
+	if (index < 0 || index >= ARRAY_SIZE(netdev_table))
+		return NULL;
+
+	spin_lock_irqsave(&netdev_table_lock, flags);
+
+	if (test_bit(index, netdev_table_map))
+		netdev = &netdev_table[index];
+
+	spin_unlock_irqrestore(&netdev_table_lock, flags);
+
+	return netdev;
+}
+
+static void mse_netdev_demux_enqueue(struct mse_adapter_netdev *netdev,
+				     struct sk_buff *skb)
+{
+	struct sk_buff_head *rxq = &netdev->rxq;
+	unsigned long flags;
+	bool f_empty;
+
+	if (!skb)
+		return;
+
+	spin_lock_irqsave(&rxq->lock, flags);
+	if (skb_queue_len(rxq) >= MSE_NETDEV_RX_QUEUE_MAX) {
+		spin_unlock_irqrestore(&rxq->lock, flags);
+		kfree_skb(skb);
+		return;
+	}
+	f_empty = skb_queue_empty(rxq);
+	__skb_queue_tail(rxq, skb);
+	spin_unlock_irqrestore(&rxq->lock, flags);
+
+	/* reader sleeps only on empty queue */
+	if (f_empty)
+		wake_up_interruptible(&netdev->wait_rx);
+}
+
+/* called under rcu_read_lock() from the receive path */
+static void mse_netdev_demux_dispatch(struct mse_netdev_demux *demux,
+				      struct sk_buff *skb)
+{
+	struct mse_adapter_netdev *netdev, *prev = NULL;
+	u64 key;
+
+	if (skb->pkt_type == PACKET_OUTGOING)
+		goto drop;
+
+	skb = skb_share_check(skb, GFP_ATOMIC);
+	if (!skb)
+		return;
+
+	/* skb->data points to the AVTP header */
+	if (!pskb_may_pull(skb, MSE_NETDEV_STREAMID_END))
+		goto drop;
+
+	key = get_unaligned_be64(skb->data + 4);
+
+	hash_for_each_possible_rcu(demux->streams, netdev, node, key) {
+		if (netdev->key != key)
+			continue;
+		if (prev)
+			mse_netdev_demux_enqueue(prev,
+						 skb_clone(skb, GFP_ATOMIC));
+		prev = netdev;
+	}
+
+	if (!prev) {
+		hlist_for_each_entry_rcu(netdev, &demux->any, node) {
+			if (prev)
+				mse_netdev_demux_enqueue(
+					prev, skb_clone(skb, GFP_ATOMIC));
+			prev = netdev;
+		}
+	}
+
+	if (prev) {
+		mse_netdev_demux_enqueue(prev, skb);
+		return;
+	}
+
+drop:
+	kfree_skb(skb);
+}
+
+static int mse_netdev_demux_rcv(struct sk_buff *skb,
+				struct net_device *dev,
+				struct packet_type *pt,
+				struct net_device *orig_dev)
+{
+	struct mse_netdev_demux *demux;
+
+	demux = container_of(pt, struct mse_netdev_demux, ptype);
+
+	rcu_read_lock();
+	mse_netdev_demux_dispatch(demux, skb);
+	rcu_read_unlock();
+
+	return NET_RX_SUCCESS;
+}
+
+#if KERNEL_VERSION(4, 19, 0) <= LINUX_VERSION_CODE
+/* batch of frames from one NAPI poll */
+static void mse_netdev_demux_rcv_list(struct list_head *head,
+				      struct packet_type *pt,
+				      struct net_device *orig_dev)
+{
+	struct mse_netdev_demux *demux;
+	struct sk_buff *skb, *next;
+
+	demux = container_of(pt, struct mse_netdev_demux, ptype);
+
+	rcu_read_lock();
+	list_for_each_entry_safe(skb, next, head, list) {
+		skb_list_del_init(skb);
+		mse_netdev_demux_dispatch(demux, skb);
+	}
+	rcu_read_unlock();
+}
+#endif
+
+static struct mse_netdev_demux *mse_netdev_demux_get(struct net_device *ndev)
+{
+	struct mse_netdev_demux *demux = NULL;
+	int i;
+
+	mutex_lock(&demux_mutex);
+
+	for (i = 0; i < ARRAY_SIZE(demux_table); i++) {
+		if (demux_table[i].ndev == ndev) {
+			demux = &demux_table[i];
+			break;
+		}
+		if (!demux && !demux_table[i].ndev)
+			demux = &demux_table[i];
+	}
+
+	if (demux && !demux->ndev) {
+		/* first listener on this device */
+		demux->ndev = ndev;
+		spin_lock_init(&demux->lock);
+		hash_init(demux->streams);
+		INIT_HLIST_HEAD(&demux->any);
+		demux->ptype.type = htons(ETH_P_1722);
+		demux->ptype.dev = ndev;
+		demux->ptype.func = mse_netdev_demux_rcv;
+#if KERNEL_VERSION(4, 19, 0) <= LINUX_VERSION_CODE
+		demux->ptype.list_func = mse_netdev_demux_rcv_list;
+#endif
+		dev_add_pack(&demux->ptype);
+
+		/* AVTP streams are sent to multicast addresses */
+		rtnl_lock();
+		if (dev_set_allmulti(ndev, 1))
+			mse_err("cannot set allmulti on %s\n", ndev->name);
+		rtnl_unlock();
+	}
+
+	if (demux)
+		demux->users++;
+
+	mutex_unlock(&demux_mutex);
+
+	return demux;
+}
+
+static void mse_netdev_demux_put(struct mse_netdev_demux *demux)
+{
+	mutex_lock(&demux_mutex);
+
+	if (!--demux->users) {
+		rtnl_lock();
+		dev_set_allmulti(demux->ndev, -1);
+		rtnl_unlock();
+
+		/* waits for receive path in flight */
+		dev_remove_pack(&demux->ptype);
+		memset(demux, 0, sizeof(*demux));
+	}
+
+	mutex_unlock(&demux_mutex);
+}
+
+static void mse_netdev_demux_link(struct mse_adapter_netdev *netdev)
+{
+	struct mse_netdev_demux *demux = netdev->demux;
+
+	spin_lock_bh(&demux->lock);
+	if (netdev->f_streamid)
+		hash_add_rcu(demux->streams, &netdev->node, netdev->key);
+	else
+		hlist_add_head_rcu(&netdev->node, &demux->any);
+	netdev->f_linked = true;
+	spin_unlock_bh(&demux->lock);
+}
+
+static void mse_netdev_demux_unlink(struct mse_adapter_netdev *netdev)
+{
+	struct mse_netdev_demux *demux = netdev->demux;
+
+	spin_lock_bh(&demux->lock);
+	hlist_del_init_rcu(&netdev->node);
+	netdev->f_linked = false;
+	spin_unlock_bh(&demux->lock);
+
+	synchronize_net();
+}
+
+#if KERNEL_VERSION(4, 15, 0) <= LINUX_VERSION_CODE
+static int mse_adapter_netdev_setup_cbs(struct mse_adapter_netdev *netdev,
+					struct mse_cbsparam *cbs)
+{
+	struct net_device *ndev = netdev->ndev;
+	struct tc_cbs_qopt_offload qopt;
+	struct ethtool_link_ksettings ks;
+	s64 port_rate, idleslope, sendslope;
+	int err;
+
+	if (!ndev->netdev_ops->ndo_setup_tc)
+		return 0;
+
+	rtnl_lock();
+
+	err = __ethtool_get_link_ksettings(ndev, &ks);
+	if (err || ks.base.speed == SPEED_UNKNOWN || !ks.base.speed)
+		port_rate = MSE_NETDEV_LINK_SPEED_DEFAULT;
+	else
+		port_rate = ks.base.speed;
+
+	/* kbps */
+	port_rate *= 1000;
+	idleslope = (port_rate * cbs->bandwidth_fraction) >> 32;
+	sendslope = idleslope - port_rate;
+
+	memset(&qopt, 0, sizeof(qopt));
+	qopt.enable = cbs->bandwidth_fraction ? 1 : 0;
+	qopt.queue = netdev_cbs_queue;
+	qopt.idleslope = idleslope;
+	qopt.sendslope = sendslope;
+	qopt.hicredit = div64_s64(ETHFRAMELEN_MAX * idleslope, port_rate);
+	qopt.locredit = div64_s64(ETHFRAMELEN_MAX * sendslope, port_rate);
+
+	err = ndev->netdev_ops->ndo_setup_tc(ndev, TC_SETUP_QDISC_CBS, &qopt);
+
+	rtnl_unlock();
+
+	if (err == -EOPNOTSUPP) {
+		mse_debug("CBS offload not supported by %s\n", ndev->name);
+		return 0;
+	}
+
+	if (err)
+		return err;
+
+	netdev->f_cbs_offload = qopt.enable;
+
+	return 0;
+}
+#else
+static int mse_adapter_netdev_setup_cbs(struct mse_adapter_netdev *netdev,
+					struct mse_cbsparam *cbs)
+{
+	return 0;
+}
+#endif
+
+static int mse_adapter_netdev_open(char *name)
+{
+	struct mse_adapter_netdev *netdev;
+	struct net_device *ndev;
+	char devname[MSE_NAME_LEN_MAX + 1];
+
+	if (!name) {
+		mse_err("invalid argument. name\n");
+		return -EINVAL;
+	}
+
+	mse_name_strlcpy(devname, name);
+	ndev = dev_get_by_name(&init_net, devname);
+	if (!ndev) {
+		mse_err("error unknown dev=%s\n", devname);
+		return -ENODEV;
+	}
+
+	mse_debug("dev=%s\n", devname);
+
+	netdev = mse_adapter_netdev_alloc_priv(ndev);
+	if (!netdev) {
+		dev_put(ndev);
+		return -EPERM;
+	}
+
+	skb_queue_head_init(&netdev->rxq);
+	init_waitqueue_head(&netdev->wait_rx);
+
+	return netdev->index;
+}
+
+static int mse_adapter_netdev_release(int index)
+{
+	struct mse_adapter_netdev *netdev;
+	struct mse_cbsparam cbs;
+
+	mse_debug("index=%d\n", index);
+
+	netdev = mse_adapter_netdev_get_priv(index);
+	if (!netdev)
+		return -EPERM;
+
+	if (netdev->demux) {
+		if (netdev->f_linked)
+			mse_netdev_demux_unlink(netdev);
+		mse_netdev_demux_put(netdev->demux);
+	}
+
+	skb_queue_purge(&netdev->rxq);
+
+	if (netdev->f_cbs_offload) {
+		memset(&cbs, 0, sizeof(cbs));
+		mse_adapter_netdev_setup_cbs(netdev, &cbs);
+	}
+
+	dev_put(netdev->ndev);
+	mse_adapter_netdev_free_priv(netdev->index);
+
+	return 0;
+}
+
+static int mse_adapter_netdev_set_cbs_param(int index,
+					    struct mse_cbsparam *cbs)
+{
+	int err;
+	struct mse_adapter_netdev *netdev;
+
+	mse_debug("index=%d\n", index);
+
+	netdev = mse_adapter_netdev_get_priv(index);
+	if (!netdev)
+		return -EPERM;
+
+	if (!cbs) {
+		mse_err("invalid argument. cbs\n");
+		return -EINVAL;
+	}
+
+	mse_debug(" bandwidthFraction = %08x\n", cbs->bandwidth_fraction);
+
+	/* shaping is done by the cbs qdisc configured on the device */
+	if (netdev_cbs_queue < 0)
+		return 0;
+
+	err = mse_adapter_netdev_setup_cbs(netdev, cbs);
+	if (err) {
+		mse_err("error setup CBS offload code=%d\n", err);
+		return err;
+	}
+
+	return 0;
+}
+
+static int mse_adapter_netdev_set_streamid(int index, u8 streamid[8])
+{
+	struct mse_adapter_netdev *netdev;
+
+	mse_debug("index=%d\n", index);
+
+	netdev = mse_adapter_netdev_get_priv(index);
+	if (!netdev)
+		return -EPERM;
+
+	if (!streamid) {
+		mse_err("invalid argument. streamid\n");
+		return -EINVAL;
+	}
+
+	/* move to the hash bucket of new stream ID */
+	if (netdev->f_linked)
+		mse_netdev_demux_unlink(netdev);
+
+	netdev->key = get_unaligned_be64(streamid);
+	netdev->f_streamid = true;
+
+	if (netdev->demux)
+		mse_netdev_demux_link(netdev);
+
+	mse_debug(" streamid=%02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x\n",
+		  streamid[0], streamid[1], streamid[2], streamid[3],
+		  streamid[4], streamid[5], streamid[6], streamid[7]);
+
+	return 0;
+}
+
+static int mse_adapter_netdev_send_prepare(int index,
+					   struct mse_packet *packets,
+					   int num_packets)
+{
+	struct mse_adapter_netdev *netdev;
+
+	mse_debug("index=%d addr=%p num=%d\n", index, packets, num_packets);
+
+	netdev = mse_adapter_netdev_get_priv(index);
+	if (!netdev)
+		return -EPERM;
+
+	if (!packets) {
+		mse_err("invalid argument. packets\n");
+		return -EINVAL;
+	}
+
+	if (num_packets <= 0)
+		return -EINVAL;
+
+	if (num_packets > MSE_NETDEV_ADAPTER_PACKET_MAX) {
+		mse_err("too much packets %d\n", num_packets);
+		return -EINVAL;
+	}
+
+	netdev->f_tx = true;
+	netdev->packets = packets;
+	netdev->num_entry = num_packets;
+	netdev->unentry = 0;
+
+	return 0;
+}
+
+static int mse_adapter_netdev_send(int index,
+				   struct mse_packet *packets,
+				   int num_packets)
+{
+	int i, ofs, err;
+	struct mse_adapter_netdev *netdev;
+	struct net_device *ndev;
+	struct sk_buff *skb;
+	struct mse_packet *packet;
+	struct vlan_ethhdr *vhdr;
+
+	mse_debug("index=%d num=%d\n", index, num_packets);
+
+	netdev = mse_adapter_netdev_get_priv(index);
+	if (!netdev)
+		return -EPERM;
+
+	if (!netdev->f_tx)
+		return -EPERM;
+
+	if (!packets) {
+		mse_err("invalid argument. packets\n");
+		return -EINVAL;
+	}
+
+	if (num_packets <= 0)
+		return -EINVAL;
+
+	if (num_packets > MSE_NETDEV_ADAPTER_ENTRY_MAX) {
+		mse_err("too much packets\n");
+		return -EINVAL;
+	}
+
+	ndev = netdev->ndev;
+
+	for (i = 0; i < num_packets; i++) {
+		ofs = (netdev->unentry + i) % netdev->num_entry;
+		packet = &packets[ofs];
+
+		/* headroom for the device, packet has its Ethernet header */
+		skb = alloc_skb(packet->len + LL_RESERVED_SPACE(ndev),
+				GFP_ATOMIC);
+		if (!skb) {
+			mse_err("cannot allocate skb\n");
+			break;
+		}
+
+		skb_reserve(skb, LL_RESERVED_SPACE(ndev));
+		skb_put_data(skb, packet->vaddr, packet->len);
+		skb_reset_mac_header(skb);
+
+		vhdr = (struct vlan_ethhdr *)skb->data;
+		skb->protocol = vhdr->h_vlan_proto;
+		if (skb->protocol == htons(ETH_P_8021Q)) {
+			skb->priority = ntohs(vhdr->h_vlan_TCI) >>
+				VLAN_PRIO_SHIFT;
+			skb_set_network_header(skb, VLAN_ETH_HLEN);
+		} else {
+			skb_set_network_header(skb, ETH_HLEN);
+		}
+		skb->dev = ndev;
+
+		/* txtime for the etf qdisc, needs skip_sock_check */
+		if (netdev->f_launch_time && packet->launch_time)
+			skb->tstamp = ns_to_ktime(packet->launch_time);
+
+		/* skb is consumed even when it is dropped */
+		err = dev_queue_xmit(skb);
+		if (err != NET_XMIT_SUCCESS)
+			mse_debug("xmit error %d\n", err);
+	}
+
+	netdev->unentry = (netdev->unentry + i) % netdev->num_entry;
+
+	return i;
+}
+
+static int mse_adapter_netdev_receive_prepare(int index,
+					      struct mse_packet *packets,
+					      int num_packets)
+{
+	struct mse_adapter_netdev *netdev;
+
+	mse_debug("index=%d addr=%p num=%d\n", index, packets, num_packets);
+
+	netdev = mse_adapter_netdev_get_priv(index);
+	if (!netdev)
+		return -EPERM;
+
+	if (!packets) {
+		mse_err("invalid argument. packets\n");
+		return -EINVAL;
+	}
+
+	if (num_packets <= 0)
+		return -EINVAL;
+
+	if (num_packets > MSE_NETDEV_ADAPTER_PACKET_MAX) {
+		mse_err("too much packets\n");
+		return -EINVAL;
+	}
+
+	netdev->f_tx = false;
+	netdev->packets = packets;
+	netdev->num_entry = num_packets;
+	netdev->unentry = 0;
+	netdev->f_cancel = false;
+
+	if (!netdev->demux) {
+		netdev->demux = mse_netdev_demux_get(netdev->ndev);
+		if (!netdev->demux) {
+			mse_err("too many devices with listeners\n");
+			return -EBUSY;
+		}
+	}
+
+	if (!netdev->f_linked)
+		mse_netdev_demux_link(netdev);
+
+	return 0;
+}
+
+static int mse_adapter_netdev_copy_skb(struct mse_packet *packet,
+				       struct sk_buff *skb)
+{
+	u8 *dst = packet->vaddr;
+	unsigned int len;
+	u16 tci = 0;
+
+	len = min_t(unsigned int, skb->len, MSE_NETDEV_PACKET_LENGTH -
+		    AVTP_OFFSET);
+
+	/* rebuild DA + SA + Q-Tag + EtherType as sent on the wire */
+	ether_addr_copy(dst, eth_hdr(skb)->h_dest);
+	ether_addr_copy(dst + ETH_ALEN, eth_hdr(skb)->h_source);
+	if (skb_vlan_tag_present(skb))
+		tci = skb_vlan_tag_get(skb);
+	*(__be16 *)(dst + 12) = htons(ETH_P_8021Q);
+	*(__be16 *)(dst + 14) = htons(tci);
+	*(__be16 *)(dst + 16) = htons(ETH_P_1722);
+
+	if (skb_copy_bits(skb, 0, dst + AVTP_OFFSET, len))
+		return -EFAULT;
+
+	packet->len = AVTP_OFFSET + len;
+
+	return 0;
+}
+
+static int mse_adapter_netdev_receive(int index, int num_packets)
+{
+	int receive = 0, ofs, err;
+	struct mse_adapter_netdev *netdev;
+	struct sk_buff *skb;
+
+	mse_debug("index=%d num=%d\n", index, num_packets);
+
+	netdev = mse_adapter_netdev_get_priv(index);
+	if (!netdev)
+		return -EPERM;
+
+	if (netdev->f_tx)
+		return -EPERM;
+
+	if (num_packets <= 0)
+		return -EINVAL;
+
+	if (num_packets > MSE_NETDEV_ADAPTER_ENTRY_MAX) {
+		mse_err("too much packets\n");
+		return -EINVAL;
+	}
+
+	err = wait_event_interruptible(netdev->wait_rx,
+				       !skb_queue_empty(&netdev->rxq) ||
+				       netdev->f_cancel);
+	if (err) {
+		mse_info("receive error %d\n", err);
+		return err;
+	}
+
+	if (netdev->f_cancel) {
+		netdev->f_cancel = false;
+		mse_info("receive canceled\n");
+		return -EINTR;
+	}
+
+	while (receive < num_packets) {
+		skb = skb_dequeue(&netdev->rxq);
+		if (!skb)
+			break;
+
+		ofs = (netdev->unentry + receive) % netdev->num_entry;
+		err = mse_adapter_netdev_copy_skb(&netdev->packets[ofs], skb);
+		kfree_skb(skb);
+		if (err)
+			continue;
+
+		receive++;
+	}
+
+	netdev->unentry = (netdev->unentry + receive) % netdev->num_entry;
+
+	return receive;
+}
+
+static int mse_adapter_netdev_cancel(int index)
+{
+	struct mse_adapter_netdev *netdev;
+
+	netdev = mse_adapter_netdev_get_priv(index);
+	if (!netdev)
+		return -EPERM;
+
+	netdev->f_cancel = true;
+	wake_up_interruptible(&netdev->wait_rx);
+
+	return 0;
+}
+
+static int mse_adapter_netdev_get_link_speed(int index)
+{
+	int err, link_speed;
+	struct mse_adapter_netdev *netdev;
+	struct ethtool_link_ksettings ks;
+
+	mse_debug("index=%d\n", index);
+
+	netdev = mse_adapter_netdev_get_priv(index);
+	if (!netdev)
+		return -EPERM;
+
+	if (!netif_carrier_ok(netdev->ndev))
+		return 0;
+
+	rtnl_lock();
+	err = __ethtool_get_link_ksettings(netdev->ndev, &ks);
+	rtnl_unlock();
+
+	if (err || ks.base.speed == SPEED_UNKNOWN || !ks.base.speed) {
+		mse_debug("unknown link speed, assume %dMbps\n",
+			  MSE_NETDEV_LINK_SPEED_DEFAULT);
+		link_speed = MSE_NETDEV_LINK_SPEED_DEFAULT;
+	} else {
+		link_speed = ks.base.speed;
+	}
+
+	/* return speed as Mbps */
+	return link_speed;
+}
+
+static int mse_adapter_netdev_set_launch_time(int index, bool enable)
+{
+	struct mse_adapter_netdev *netdev;
+
+	mse_debug("index=%d enable=%d\n", index, enable);
+
+	netdev = mse_adapter_netdev_get_priv(index);
+	if (!netdev)
+		return -EPERM;
+
+	if (!netdev->f_tx)
+		return -EPERM;
+
+#if KERNEL_VERSION(4, 19, 0) <= LINUX_VERSION_CODE
+	netdev->f_launch_time = enable;
+
+	return 0;
+#else
+	return -EOPNOTSUPP;
+#endif
+}
+
+static struct mse_adapter_network_ops mse_adapter_netdev_ops = {
+	.name = "netdev",
+	.type = MSE_TYPE_ADAPTER_NETWORK,
+	.f_send_copy = true,
+	.open = mse_adapter_netdev_open,
+	.release = mse_adapter_netdev_release,
+	.set_cbs_param = mse_adapter_netdev_set_cbs_param,
+	.set_streamid = mse_adapter_netdev_set_streamid,
+	.send_prepare = mse_adapter_netdev_send_prepare,
+	.send = mse_adapter_netdev_send,
+	.receive_prepare = mse_adapter_netdev_receive_prepare,
+	.receive = mse_adapter_netdev_receive,
+	.cancel = mse_adapter_netdev_cancel,
+	.get_link_speed = mse_adapter_netdev_get_link_speed,
+	.set_launch_time = mse_adapter_netdev_set_launch_time,
+};
+
+static int __init mse_adapter_netdev_init(void)
+{
+	mse_debug("START\n");
+
+	adapter_index = mse_register_adapter_network(&mse_adapter_netdev_ops);
+	if (adapter_index < 0) {
+		mse_err("cannot register\n");
+		return -EPERM;
+	}
+
+	return 0;
+}
+
+static void __exit mse_adapter_netdev_exit(void)
+{
+	mse_debug("START\n");
+	mse_unregister_adapter_network(adapter_index);
+}
+
+module_init(mse_adapter_netdev_init);
+module_exit(mse_adapter_netdev_exit);
+
+MODULE_AUTHOR("Renesas Electronics Corporation");
+MODULE_DESCRIPTION("Renesas Media Streaming Engine");
+MODULE_LICENSE("Dual MIT/GPL");
@@ -68,6 +68,7 @@
 #include <linux/init.h>
 #include <linux/kmod.h>
 #include <linux/mutex.h>
+#include <linux/vmalloc.h>
 #include <linux/fs.h>
 #include <linux/platform_device.h>
 #include <linux/videodev2.h>
@@ -103,15 +104,30 @@
 #define MSE_ADAPTER_V4L2_MPEG2TS_BYTESPERLINE   (188 * 192)
 #define MSE_ADAPTER_V4L2_MPEG2TS_SIZEIMAGE \
 	(MSE_ADAPTER_V4L2_MPEG2TS_BYTESPERLINE * 14)
-#define MSE_ADAPTER_V4L2_TEMP_BUF_MAXSIZE       (2048 * 1024)
+#define MSE_ADAPTER_V4L2_TEMP_BUF_NUM_DEFAULT   (2)
+#define MSE_ADAPTER_V4L2_TEMP_BUF_NUM_MAX       (8)
+/* partial TS packet carried over to next temp buffer */
+#define MSE_ADAPTER_V4L2_TEMP_BUF_MARGIN        (4 + 188)
+#define MSE_ADAPTER_V4L2_INFLIGHT_DEFAULT       (2)
+#define MSE_ADAPTER_V4L2_INFLIGHT_MAX           (8)
 
 /*************/
 /* Structure */
 /*************/
+/* Buffer state, each state has own list in v4l2_adapter_device */
+enum v4l2_adapter_buffer_state {
+	V4L2_ADAPTER_BUF_QUEUED,	/* queued from v4l2 core */
+	V4L2_ADAPTER_BUF_PREPARED,	/* ready to pass to MSE */
+	V4L2_ADAPTER_BUF_STREAMING,	/* MSE processing */
+};
+
 /* Buffer information */
 struct v4l2_adapter_buffer {
 	struct vb2_v4l2_buffer vb;
 	struct list_head list;
+	enum v4l2_adapter_buffer_state state;
+	/* output carries a part of frame, more parts follow */
+	bool partial;
 };
 
 struct v4l2_adapter_temp_buffer {
@@ -119,6 +135,7 @@ struct v4l2_adapter_temp_buffer {
 	size_t length;
 	unsigned char *buf;
 	bool prepared;
+	bool frame_end;
 };
 
 /* File handle information */
@@ -138,6 +155,9 @@ struct v4l2_adapter_device {
 	struct v4l2_fract	frameintervals;
 	struct vb2_queue	q_cap;
 	struct vb2_queue	q_out;
+	/* partial frame control of video output */
+	struct v4l2_ctrl_handler ctrl_handler;
+	bool			f_partial;
 	/* spin lock */
 	spinlock_t		lock_buf_list;    /* lock for buf_list */
 	/* list of buffer queued from v4l2 core */
@@ -147,6 +167,9 @@ struct v4l2_adapter_device {
 	/* list of buffer mse processing */
 	struct list_head	stream_buf_list;
 	unsigned int		sequence;
+	/* capture timestamp of frame, shared by its partial buffers */
+	u64			frame_timestamp;
+	bool			f_frame_start;
 	/* for buffer management debug */
 	unsigned int		queued;
 	unsigned int		dequeued;
@@ -156,15 +179,19 @@ struct v4l2_adapter_device {
 	/* index for MSE instance */
 	int			index_instance;
 	bool			f_mse_open;
-	/* previous trans buffer for checking buffer overwite */
-	void			*prev;
+	/* number of buffers in stream_buf_list, and its limit */
+	int			streaming_num;
+	int			streaming_max;
 
 	/* temp video buffer */
 	bool			use_temp_buffer;
-	struct v4l2_adapter_temp_buffer		temp_buf[NUM_BUFFERS];
+	struct v4l2_adapter_temp_buffer
+				temp_buf[MSE_ADAPTER_V4L2_TEMP_BUF_NUM_MAX];
 	void *temp_buf_base;
-	int temp_w;
-	int temp_r;
+	int temp_buf_num;
+	int temp_w;		/* next slot to write */
+	int temp_s;		/* next prepared slot to pass to MSE */
+	int temp_r;		/* oldest slot MSE processing */
 
 	/* mpeg2ts stream type */
 	enum MSE_MPEG2TS_TYPE	mpeg2ts_type;
@@ -265,6 +292,14 @@ static int v4l2_video_devices = MSE_ADAPTER_V4L2_DEVICE_VIDEO_DEFAULT;
 module_param(v4l2_video_devices, int, 0440);
 static int v4l2_mpeg2ts_devices = MSE_ADAPTER_V4L2_DEVICE_MPEG2TS_DEFAULT;
 module_param(v4l2_mpeg2ts_devices, int, 0440);
+static int v4l2_temp_buffers = MSE_ADAPTER_V4L2_TEMP_BUF_NUM_DEFAULT;
+module_param(v4l2_temp_buffers, int, 0440);
+MODULE_PARM_DESC(v4l2_temp_buffers,
+		 "Depth of temp buffer ring for unaligned output (2-8)");
+static int v4l2_inflight_buffers = MSE_ADAPTER_V4L2_INFLIGHT_DEFAULT;
+module_param(v4l2_inflight_buffers, int, 0440);
+MODULE_PARM_DESC(v4l2_inflight_buffers,
+		 "Number of buffers passed to MSE at once (1-8)");
 static int v4l2_devices;
 
 /************/
@@ -276,6 +311,8 @@ static int v4l2_devices;
 		struct v4l2_adapter_buffer *__buf = (vadp_buf); \
 		mse_debug("queued=%u dequeued=%u\n", \
 			__dev->queued, ++(__dev->dequeued)); \
+		if (__buf->state == V4L2_ADAPTER_BUF_STREAMING) \
+			__dev->streaming_num--; \
 		list_del(&__buf->list); \
 		vb2_buffer_done(&__buf->vb.vb2_buf, (state)); \
 	} while (0)
@@ -295,41 +332,51 @@ static void temp_buffer_free(struct v4l2_adapter_device *vadp_dev)
 	if (!vadp_dev->temp_buf_base)
 		return;
 
-	for (i = 0; i < NUM_BUFFERS; i++) {
+	for (i = 0; i < vadp_dev->temp_buf_num; i++) {
 		temp = &vadp_dev->temp_buf[i];
 		temp->buf = NULL;
 		temp->length = 0;
 	}
 
-	kfree(vadp_dev->temp_buf_base);
+	vfree(vadp_dev->temp_buf_base);
 	vadp_dev->temp_buf_base = NULL;
+	vadp_dev->temp_buf_num = 0;
 }
 
 static int temp_buffer_alloc(struct v4l2_adapter_device *vadp_dev)
 {
 	int i;
 	struct v4l2_adapter_temp_buffer *temp;
-	u32 length;
+	size_t length;
+	int num;
 	u8 *buf;
 
 	/* already allocated, skip allocate memory */
 	if (vadp_dev->temp_buf_base)
 		return 0;
 
-	length = min_t(u32, vadp_dev->format.sizeimage,
-		       MSE_ADAPTER_V4L2_TEMP_BUF_MAXSIZE);
+	num = clamp_t(int, v4l2_temp_buffers, 2,
+		      MSE_ADAPTER_V4L2_TEMP_BUF_NUM_MAX);
+
+	/* one frame or one V4L2 buffer of TS, page granular */
+	length = PAGE_ALIGN((size_t)vadp_dev->format.sizeimage +
+			    MSE_ADAPTER_V4L2_TEMP_BUF_MARGIN);
 
-	buf = kmalloc_array((size_t)length, NUM_BUFFERS, GFP_KERNEL);
+	buf = vmalloc(length * num);
 	if (!buf)
 		return -ENOMEM;
 
+	mse_debug("temp buffer %d x %zu\n", num, length);
+
 	vadp_dev->temp_buf_base = buf;
+	vadp_dev->temp_buf_num = num;
 	vadp_dev->temp_w = 0;
+	vadp_dev->temp_s = 0;
 	vadp_dev->temp_r = 0;
 
-	for (i = 0; i < NUM_BUFFERS; i++) {
+	for (i = 0; i < num; i++) {
 		temp = &vadp_dev->temp_buf[i];
-		temp->length = (size_t)length;
+		temp->length = length;
 		temp->buf = buf + (temp->length * i);
 		temp->prepared = false;
 		temp->bytesused = 0;
@@ -343,13 +390,26 @@ static struct v4l2_adapter_temp_buffer *temp_buffer_get_prepared(
 {
 	struct v4l2_adapter_temp_buffer *temp;
 
-	temp = &vadp_dev->temp_buf[vadp_dev->temp_r];
+	temp = &vadp_dev->temp_buf[vadp_dev->temp_s];
 	if (!temp->prepared)
 		return NULL;
 
 	return temp;
 }
 
+static void temp_buffer_put(struct v4l2_adapter_device *vadp_dev)
+{
+	struct v4l2_adapter_temp_buffer *temp;
+
+	temp = &vadp_dev->temp_buf[vadp_dev->temp_r];
+	if (!temp->prepared)
+		return;
+
+	temp->prepared = false;
+	temp->bytesused = 0;
+	vadp_dev->temp_r = (vadp_dev->temp_r + 1) % vadp_dev->temp_buf_num;
+}
+
 #define MPEG2TS_TS_SIZE         (188)
 #define MPEG2TS_SYNC            (0x47)
 #define MPEG2TS_M2TS_OFFSET     (4)
@@ -444,7 +504,8 @@ static int temp_buffer_check_type(struct v4l2_adapter_device *vadp_dev,
 
 static int temp_buffer_write_mpeg2ts(struct v4l2_adapter_device *vadp_dev,
 				     unsigned char *buf,
-				     size_t size)
+				     size_t size,
+				     bool frame_end)
 {
 	struct v4l2_adapter_temp_buffer *temp;
 	unsigned char *copy_from;
@@ -453,6 +514,7 @@ static int temp_buffer_write_mpeg2ts(struct v4l2_adapter_device *vadp_dev,
 	size_t psize;
 	int temp_w = vadp_dev->temp_w;
 	int temp_r = vadp_dev->temp_r;
+	int num = vadp_dev->temp_buf_num;
 
 	temp = &vadp_dev->temp_buf[temp_w];
 
@@ -470,7 +532,7 @@ static int temp_buffer_write_mpeg2ts(struct v4l2_adapter_device *vadp_dev,
 	else
 		psize = MPEG2TS_TS_SIZE;
 
-	if (!((temp_w + NUM_BUFFERS - temp_r - 1) % NUM_BUFFERS > 0)) {
+	if (!((temp_w + num - temp_r - 1) % num > 0)) {
 		if (bytesused + size % psize) {
 			mse_debug("temp buffer has no enough area\n");
 			return -EAGAIN;
@@ -494,7 +556,8 @@ static int temp_buffer_write_mpeg2ts(struct v4l2_adapter_device *vadp_dev,
 	pos = bytesused - bytesused % psize;
 	temp->bytesused = pos;
 	temp->prepared = true;
-	vadp_dev->temp_w = (temp_w + 1) % NUM_BUFFERS;
+	temp->frame_end = frame_end;
+	vadp_dev->temp_w = (temp_w + 1) % num;
 
 	if (pos == bytesused)
 		return 0;
@@ -520,6 +583,7 @@ static int temp_buffer_write_mjpeg(struct v4l2_adapter_device *vadp_dev,
 	size_t copy_size = size;
 	int temp_w = vadp_dev->temp_w;
 	int temp_r = vadp_dev->temp_r;
+	int num = vadp_dev->temp_buf_num;
 
 	temp = &vadp_dev->temp_buf[temp_w];
 
@@ -533,7 +597,7 @@ static int temp_buffer_write_mjpeg(struct v4l2_adapter_device *vadp_dev,
 		  temp_w, bytesused, buf, size);
 
 	pos = jpeg_search_eoi(buf, size, 0);
-	if (!((temp_w + NUM_BUFFERS - temp_r - 1) % NUM_BUFFERS > 0)) {
+	if (!((temp_w + num - temp_r - 1) % num > 0)) {
 		if (pos != size) {
 			mse_debug("temp buffer has no enough area\n");
 			return -EAGAIN;
@@ -553,9 +617,11 @@ static int temp_buffer_write_mjpeg(struct v4l2_adapter_device *vadp_dev,
 	memcpy(temp->buf + bytesused, copy_from, copy_size);
 	temp->bytesused += copy_size;
 
+	/* temp buffer is prepared with a whole JPEG frame */
 	if (jpeg_frame_is_valid(temp->buf, temp->bytesused)) {
 		temp->prepared = true;
-		vadp_dev->temp_w = (temp_w + 1) % NUM_BUFFERS;
+		temp->frame_end = true;
+		vadp_dev->temp_w = (temp_w + 1) % num;
 	}
 
 	if (size == pos)
@@ -574,10 +640,12 @@ static int temp_buffer_write_mjpeg(struct v4l2_adapter_device *vadp_dev,
 
 static int temp_buffer_write(struct v4l2_adapter_device *vadp_dev,
 			     unsigned char *buf,
-			     size_t size)
+			     size_t size,
+			     bool frame_end)
 {
 	if (vadp_dev->format.pixelformat == V4L2_PIX_FMT_MPEG)
-		return temp_buffer_write_mpeg2ts(vadp_dev, buf, size);
+		return temp_buffer_write_mpeg2ts(vadp_dev, buf, size,
+						 frame_end);
 	else if (vadp_dev->format.pixelformat == V4L2_PIX_FMT_MJPEG)
 		return temp_buffer_write_mjpeg(vadp_dev, buf, size);
 	else
@@ -609,6 +677,29 @@ static inline struct v4l2_adapter_buffer *to_v4l2_adapter_buffer(
 	return container_of(vbuf, struct v4l2_adapter_buffer, vb);
 }
 
+/* Move buffer to the list of the state, lock_buf_list must be held */
+static void vadp_buffer_set_state(struct v4l2_adapter_device *vadp_dev,
+				  struct v4l2_adapter_buffer *vadp_buf,
+				  enum v4l2_adapter_buffer_state state)
+{
+	switch (state) {
+	case V4L2_ADAPTER_BUF_PREPARED:
+		list_move_tail(&vadp_buf->list, &vadp_dev->prepared_buf_list);
+		break;
+	case V4L2_ADAPTER_BUF_STREAMING:
+		list_move_tail(&vadp_buf->list, &vadp_dev->stream_buf_list);
+		vadp_dev->streaming_num++;
+		break;
+	case V4L2_ADAPTER_BUF_QUEUED:
+	default:
+		/* buffer from v4l2 core is not linked yet */
+		list_add_tail(&vadp_buf->list, &vadp_dev->buf_list);
+		break;
+	}
+
+	vadp_buf->state = state;
+}
+
 /* Get V4L2 Adapter device ownership */
 static int vadp_owner_get(struct v4l2_adapter_fh *vadp_fh)
 {
@@ -759,7 +850,7 @@ static int mse_adapter_v4l2_fop_release(struct file *filp)
 
 			req.count = 0;
 			req.type = vadp_dev->vdev.queue->type;
-			req.memory = V4L2_MEMORY_MMAP;
+			req.memory = vadp_dev->vdev.queue->memory;
 			err = vb2_ioctl_reqbufs(filp,
 						filp->private_data,
 						&req);
@@ -1094,9 +1185,24 @@ static int mse_adapter_v4l2_streamon(struct file *filp,
 	}
 
 	vadp_dev->sequence = 0;
+	vadp_dev->f_frame_start = true;
 	vadp_dev->queued = 0;
 	vadp_dev->dequeued = 0;
-	vadp_dev->prev = NULL;
+	vadp_dev->streaming_num = 0;
+	vadp_dev->streaming_max = clamp_t(int, v4l2_inflight_buffers, 1,
+					  MSE_ADAPTER_V4L2_INFLIGHT_MAX);
+
+	/* MSE must not hold more buffers than are passed at once */
+	if (V4L2_TYPE_IS_OUTPUT(i)) {
+		err = mse_set_trans_depth(vadp_dev->index_instance,
+					  vadp_dev->streaming_max);
+		if (err < 0) {
+			temp_buffer_free(vadp_dev);
+			try_mse_close(vadp_dev);
+
+			return err;
+		}
+	}
 
 	mse_debug("END\n");
 	return vb2_ioctl_streamon(filp, priv, i);
@@ -1310,6 +1416,7 @@ static int mse_adapter_v4l2_buf_prepare(struct vb2_buffer *vb)
 {
 	unsigned long plane_size;
 	struct vb2_v4l2_buffer *vbuf = to_vb2_v4l2_buffer(vb);
+	struct v4l2_adapter_buffer *vadp_buf = to_v4l2_adapter_buffer(vbuf);
 	struct v4l2_adapter_device *vadp_dev = vb2_get_drv_priv(vb->vb2_queue);
 
 	mse_debug("START vb=%p\n", vb2_plane_vaddr(vb, 0));
@@ -1326,6 +1433,10 @@ static int mse_adapter_v4l2_buf_prepare(struct vb2_buffer *vb)
 		return -EINVAL;
 	}
 
+	/* latch partial frame control at queueing of buffer */
+	vadp_buf->partial = V4L2_TYPE_IS_OUTPUT(vb->type) &&
+			    READ_ONCE(vadp_dev->f_partial);
+
 	mse_debug("END\n");
 
 	return 0;
@@ -1370,44 +1481,13 @@ static void mse_adapter_v4l2_stop_streaming(struct vb2_queue *vq)
 	mse_debug("END\n");
 }
 
-static void remove_duplicate_buffer(struct v4l2_adapter_device *vadp_dev,
-				    struct v4l2_adapter_buffer *buf)
-{
-	struct v4l2_adapter_buffer *buf_next;
-	void *buf_vaddr, *buf_next_vaddr;
-	unsigned long buf_size, buf_next_size;
-
-	if (list_is_singular(&vadp_dev->buf_list))
-		buf_next = NULL;
-	else
-		buf_next = list_next_entry(buf, list);
-
-	if (!buf_next)
-		return;
-
-	buf_size = vb2_get_plane_payload(&buf->vb.vb2_buf, 0);
-	buf_next_size = vb2_get_plane_payload(&buf_next->vb.vb2_buf, 0);
-	if (buf_size != buf_next_size)
-		return;
-	buf_size = min(buf_size, 4096UL);
-
-	buf_vaddr = vb2_plane_vaddr(&buf->vb.vb2_buf, 0);
-	buf_next_vaddr = vb2_plane_vaddr(&buf_next->vb.vb2_buf, 0);
-	if (memcmp(buf_vaddr, buf_next_vaddr, buf_size))
-		return;
-
-	vadp_buffer_done(vadp_dev, buf_next, VB2_BUF_STATE_DONE);
-
-	mse_info("Removed duplicate second buffer.\n");
-	mse_info(" Please set show-preroll-frame=false\n");
-}
-
 static void prepare_stream_buffer(struct vb2_queue *vq)
 {
 	struct v4l2_adapter_device *vadp_dev = vb2_get_drv_priv(vq);
 	struct v4l2_adapter_buffer *vadp_buf;
 	void *buf;
 	long size;
+	bool frame_end;
 	int ret = 0;
 
 	mse_debug("START vq=%p, type=%s\n", vq, v4l2_type_stringfy(vq->type));
@@ -1425,11 +1505,21 @@ static void prepare_stream_buffer(struct vb2_queue *vq)
 		return;
 
 	if (!V4L2_TYPE_IS_OUTPUT(vq->type)) {
-		list_move_tail(&vadp_buf->list, &vadp_dev->prepared_buf_list);
+		vadp_buffer_set_state(vadp_dev, vadp_buf,
+				      V4L2_ADAPTER_BUF_PREPARED);
 	} else {
 		buf = vb2_plane_vaddr(&vadp_buf->vb.vb2_buf, 0);
 		size = vb2_get_plane_payload(&vadp_buf->vb.vb2_buf, 0);
 
+		/* vmalloc memops cannot send buffer without kernel mapping */
+		if (!buf) {
+			mse_err("buffer has no kernel mapping\n");
+			vadp_buffer_done(vadp_dev, vadp_buf,
+					 VB2_BUF_STATE_ERROR);
+
+			return;
+		}
+
 		/* Check stream type */
 		if (vadp_dev->sequence == 0) {
 			ret = temp_buffer_check_type(vadp_dev, buf, size);
@@ -1447,26 +1537,22 @@ static void prepare_stream_buffer(struct vb2_queue *vq)
 		vadp_buf->vb.sequence = vadp_dev->sequence++;
 		vadp_buf->vb.field = vadp_dev->format.field;
 
-		/* Workaround: remove duplicated second buffer */
-		if (vadp_dev->sequence == 1)
-			remove_duplicate_buffer(vadp_dev, vadp_buf);
-
 		if (!vadp_dev->use_temp_buffer) {
-			list_move_tail(&vadp_buf->list,
-				       &vadp_dev->prepared_buf_list);
+			vadp_buffer_set_state(vadp_dev, vadp_buf,
+					      V4L2_ADAPTER_BUF_PREPARED);
 		} else {
 			/* use temp buffer */
-			struct v4l2_adapter_temp_buffer *temp;
 			int temp_w = vadp_dev->temp_w;
 
-			ret = temp_buffer_write(vadp_dev, buf, size);
+			frame_end = !vadp_buf->partial;
+			ret = temp_buffer_write(vadp_dev, buf, size, frame_end);
 			if (ret)
 				return;
 
-			temp = temp_buffer_get_prepared(vadp_dev);
-			if (temp && temp_w != vadp_dev->temp_w) {
-				list_move_tail(&vadp_buf->list,
-					       &vadp_dev->prepared_buf_list);
+			/* buffer completed a temp slot, it stands for it */
+			if (temp_w != vadp_dev->temp_w) {
+				vadp_buffer_set_state(vadp_dev, vadp_buf,
+						      V4L2_ADAPTER_BUF_PREPARED);
 			} else {
 				vadp_buffer_done(vadp_dev, vadp_buf,
 						 VB2_BUF_STATE_DONE);
@@ -1482,6 +1568,7 @@ static int set_stream_buffer(struct vb2_queue *vq)
 	struct v4l2_adapter_buffer *vadp_buf;
 	unsigned char *buf = NULL;
 	long size = 0;
+	bool frame_end = true;
 	int err;
 	unsigned long flags;
 
@@ -1505,6 +1592,14 @@ static int set_stream_buffer(struct vb2_queue *vq)
 		return 0;
 	}
 
+	if (vadp_dev->streaming_num >= vadp_dev->streaming_max) {
+		mse_debug("in-flight buffers reached %d\n",
+			  vadp_dev->streaming_num);
+		spin_unlock_irqrestore(&vadp_dev->lock_buf_list, flags);
+
+		return 0;
+	}
+
 	if (!V4L2_TYPE_IS_OUTPUT(vq->type)) {
 		buf = vb2_plane_vaddr(&vadp_buf->vb.vb2_buf, 0);
 		size = vb2_plane_size(&vadp_buf->vb.vb2_buf, 0);
@@ -1514,24 +1609,24 @@ static int set_stream_buffer(struct vb2_queue *vq)
 			if (temp) {
 				buf = temp->buf;
 				size = temp->bytesused;
+				frame_end = temp->frame_end;
 			}
 		} else {
 			buf = vb2_plane_vaddr(&vadp_buf->vb.vb2_buf, 0);
 			size = vb2_get_plane_payload(&vadp_buf->vb.vb2_buf, 0);
+			frame_end = !vadp_buf->partial;
 		}
 	}
 
 	if (!buf) {
 		mse_debug("buf is NULL\n");
-		vadp_buffer_done(vadp_dev, vadp_buf, VB2_BUF_STATE_DONE);
-		spin_unlock_irqrestore(&vadp_dev->lock_buf_list, flags);
-
-		return 0;
-	}
-
-	if (vadp_dev->prev == buf) {
-		mse_debug("current buffer is already transmissioned. prev=%p curr=%p\n",
-			  vadp_dev->prev, buf);
+		/* no temp buffer to send, or buffer without kernel mapping */
+		if (V4L2_TYPE_IS_OUTPUT(vq->type) && vadp_dev->use_temp_buffer)
+			vadp_buffer_done(vadp_dev, vadp_buf,
+					 VB2_BUF_STATE_DONE);
+		else
+			vadp_buffer_done(vadp_dev, vadp_buf,
+					 VB2_BUF_STATE_ERROR);
 		spin_unlock_irqrestore(&vadp_dev->lock_buf_list, flags);
 
 		return 0;
@@ -1539,11 +1634,12 @@ static int set_stream_buffer(struct vb2_queue *vq)
 
 	mse_debug("buf=%p size=%lu\n", buf, size);
 
-	err = mse_start_transmission(vadp_dev->index_instance,
-				     buf,
-				     size,
-				     vq,
-				     mse_adapter_v4l2_callback);
+	err = mse_start_transmission_frame(vadp_dev->index_instance,
+					   buf,
+					   size,
+					   frame_end,
+					   vq,
+					   mse_adapter_v4l2_callback);
 
 	if (err < 0) {
 		spin_unlock_irqrestore(&vadp_dev->lock_buf_list, flags);
@@ -1557,12 +1653,33 @@ static int set_stream_buffer(struct vb2_queue *vq)
 		return err;
 	}
 
-	vadp_dev->prev = buf;
-	list_move_tail(&vadp_buf->list, &vadp_dev->stream_buf_list);
+	if (vadp_dev->use_temp_buffer)
+		vadp_dev->temp_s =
+			(vadp_dev->temp_s + 1) % vadp_dev->temp_buf_num;
+
+	vadp_buffer_set_state(vadp_dev, vadp_buf, V4L2_ADAPTER_BUF_STREAMING);
 	spin_unlock_irqrestore(&vadp_dev->lock_buf_list, flags);
 
 	mse_debug("END\n");
 
+	return 1;
+}
+
+/* Pass prepared buffers to MSE until in-flight buffers reach the limit */
+static int stream_buffers(struct vb2_queue *vq)
+{
+	struct v4l2_adapter_device *vadp_dev = vb2_get_drv_priv(vq);
+	unsigned long flags;
+	int err;
+
+	do {
+		spin_lock_irqsave(&vadp_dev->lock_buf_list, flags);
+		prepare_stream_buffer(vq);
+		spin_unlock_irqrestore(&vadp_dev->lock_buf_list, flags);
+
+		err = set_stream_buffer(vq);
+	} while (err > 0);
+
 	return err;
 }
 
@@ -1573,7 +1690,6 @@ static int mse_adapter_v4l2_callback(void *priv, int size)
 	struct v4l2_adapter_device *vadp_dev;
 	unsigned long flags;
 	struct v4l2_adapter_buffer *vadp_buf;
-	struct v4l2_adapter_temp_buffer *temp;
 
 	mse_debug("START vq=%p, type=%s\n", vq, v4l2_type_stringfy(vq->type));
 
@@ -1610,29 +1726,32 @@ static int mse_adapter_v4l2_callback(void *priv, int size)
 	}
 
 	if (!V4L2_TYPE_IS_OUTPUT(vq->type)) {
+		/*
+		 * Buffers of one frame share sequence and timestamp,
+		 * sequence advances after the buffer ending the frame.
+		 */
+		if (vadp_dev->f_frame_start)
+			vadp_dev->frame_timestamp = ktime_get_ns();
+
+		vadp_dev->f_frame_start =
+			mse_is_frame_end(vadp_dev->index_instance);
+
 		vb2_set_plane_payload(&vadp_buf->vb.vb2_buf, 0, size);
-		vadp_buf->vb.vb2_buf.timestamp = ktime_get_ns();
-		vadp_buf->vb.sequence = vadp_dev->sequence++;
+		vadp_buf->vb.vb2_buf.timestamp = vadp_dev->frame_timestamp;
+		vadp_buf->vb.sequence = vadp_dev->sequence;
 		vadp_buf->vb.field = vadp_dev->format.field;
+		if (vadp_dev->f_frame_start)
+			vadp_dev->sequence++;
 	} else {
-		if (vadp_dev->use_temp_buffer) {
-			temp = temp_buffer_get_prepared(vadp_dev);
-			if (temp) {
-				temp->prepared = false;
-				temp->bytesused = 0;
-				vadp_dev->temp_r =
-					(vadp_dev->temp_r + 1) % NUM_BUFFERS;
-			}
-		}
+		if (vadp_dev->use_temp_buffer)
+			temp_buffer_put(vadp_dev);
 	}
 
 	vadp_buffer_done(vadp_dev, vadp_buf, VB2_BUF_STATE_DONE);
 
-	prepare_stream_buffer(vq);
-
 	spin_unlock_irqrestore(&vadp_dev->lock_buf_list, flags);
 
-	err = set_stream_buffer(vq);
+	err = stream_buffers(vq);
 
 	mse_debug("END err=%d\n", err);
 
@@ -1657,8 +1776,7 @@ static void mse_adapter_v4l2_buf_queue(struct vb2_buffer *vb)
 
 	spin_lock_irqsave(&vadp_dev->lock_buf_list, flags);
 
-
-	list_add_tail(&vadp_buf->list, &vadp_dev->buf_list);
+	vadp_buffer_set_state(vadp_dev, vadp_buf, V4L2_ADAPTER_BUF_QUEUED);
 	vadp_dev->queued++;
 
 	mse_debug("vb=%p queued=%u dequeued=%u\n",
@@ -1674,10 +1792,9 @@ static void mse_adapter_v4l2_buf_queue(struct vb2_buffer *vb)
 		return;
 	}
 
-	prepare_stream_buffer(vb->vb2_queue);
 	spin_unlock_irqrestore(&vadp_dev->lock_buf_list, flags);
 
-	set_stream_buffer(vb->vb2_queue);
+	stream_buffers(vb->vb2_queue);
 }
 
 static int set_media_config_mpeg(struct v4l2_adapter_device *vadp_dev)
@@ -1812,6 +1929,38 @@ error_cannot_start_streaming:
 	return err;
 }
 
+static int mse_adapter_v4l2_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct v4l2_adapter_device *vadp_dev =
+		container_of(ctrl->handler, struct v4l2_adapter_device,
+			     ctrl_handler);
+
+	switch (ctrl->id) {
+	case MSE_V4L2_CID_PARTIAL_FRAME:
+		WRITE_ONCE(vadp_dev->f_partial, ctrl->val);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static const struct v4l2_ctrl_ops g_mse_adapter_v4l2_ctrl_ops = {
+	.s_ctrl = mse_adapter_v4l2_s_ctrl,
+};
+
+static const struct v4l2_ctrl_config g_mse_adapter_v4l2_ctrl_partial = {
+	.ops	= &g_mse_adapter_v4l2_ctrl_ops,
+	.id	= MSE_V4L2_CID_PARTIAL_FRAME,
+	.name	= "Partial Frame",
+	.type	= V4L2_CTRL_TYPE_BOOLEAN,
+	.min	= 0,
+	.max	= 1,
+	.step	= 1,
+	.def	= 0,
+};
+
 static const struct vb2_ops g_mse_adapter_v4l2_queue_ops = {
 	.queue_setup		= mse_adapter_v4l2_queue_setup,
 	.wait_prepare		= vb2_ops_wait_prepare,
@@ -1881,6 +2030,29 @@ static void mse_adapter_v4l2_cleanup(struct v4l2_adapter_device *vadp_dev)
 {
 	v4l2_device_unregister(&vadp_dev->v4l2_dev);
 	video_unregister_device(&vadp_dev->vdev);
+	v4l2_ctrl_handler_free(&vadp_dev->ctrl_handler);
+}
+
+static int vadp_ctrl_handler_init(struct v4l2_adapter_device *vadp_dev)
+{
+	struct v4l2_ctrl_handler *hdl = &vadp_dev->ctrl_handler;
+
+	/* only video output is sent in parts */
+	if (!IS_MSE_TYPE_VIDEO(vadp_dev->type))
+		return 0;
+
+	v4l2_ctrl_handler_init(hdl, 1);
+	v4l2_ctrl_new_custom(hdl, &g_mse_adapter_v4l2_ctrl_partial, NULL);
+	if (hdl->error) {
+		int err = hdl->error;
+
+		v4l2_ctrl_handler_free(hdl);
+		return err;
+	}
+
+	vadp_dev->vdev.ctrl_handler = hdl;
+
+	return 0;
 }
 
 static int vadp_vb2_queue_init(struct v4l2_adapter_device *vadp_dev,
@@ -1888,7 +2060,7 @@ static int vadp_vb2_queue_init(struct v4l2_adapter_device *vadp_dev,
 			       enum v4l2_buf_type type)
 {
 	vq->type = type;
-	vq->io_modes = VB2_MMAP;
+	vq->io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
 	vq->drv_priv = vadp_dev;
 	vq->buf_struct_size = sizeof(struct v4l2_adapter_buffer);
 	vq->ops = &g_mse_adapter_v4l2_queue_ops;
@@ -1947,12 +2119,19 @@ static int mse_adapter_v4l2_probe(int dev_num, enum MSE_TYPE type)
 
 	video_set_drvdata(vdev, vadp_dev);
 
+	err = vadp_ctrl_handler_init(vadp_dev);
+	if (err) {
+		mse_err("Failed v4l2_ctrl_handler_init() Rtn=%d\n", err);
+		return err;
+	}
+
 	v4l2_dev = &vadp_dev->v4l2_dev;
 	snprintf(v4l2_dev->name, sizeof(v4l2_dev->name), "%s",
 		 MSE_ADAPTER_V4L2_NAME_BASE);
 	err = v4l2_device_register(NULL, v4l2_dev);
 	if (err) {
 		mse_err("Failed v4l2_device_register() Rtn=%d\n", err);
+		v4l2_ctrl_handler_free(&vadp_dev->ctrl_handler);
 		return -EPERM;
 	}
 
@@ -1961,6 +2140,7 @@ static int mse_adapter_v4l2_probe(int dev_num, enum MSE_TYPE type)
 	if (err) {
 		mse_err("Failed video_register_device() Rtn=%d\n", err);
 		v4l2_device_unregister(&vadp_dev->v4l2_dev);
+		v4l2_ctrl_handler_free(&vadp_dev->ctrl_handler);
 		return -EPERM;
 	}
 
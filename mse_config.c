@@ -257,6 +257,82 @@ int mse_config_get_avtp_tx_param(int index, struct mse_avtp_tx_param *data)
 	return 0;
 }
 
+int mse_config_set_avtp_tx_fanout(int index,
+				  struct mse_avtp_tx_fanout *data)
+{
+	struct mse_config *config;
+	struct mse_avtp_tx_param *param;
+	unsigned long flags;
+	int i;
+
+	if ((index < 0) || (index >= MSE_ADAPTER_MEDIA_MAX)) {
+		mse_err("invalid argument. index=%d\n", index);
+		return -EINVAL;
+	}
+	config = mse_get_dev_config(index);
+
+	if (mse_dev_is_busy(index)) {
+		mse_err("mse%d is running.\n", index);
+		return -EBUSY;
+	}
+
+	mse_debug("START\n");
+
+	if (data->num > MSE_CONFIG_FANOUT_MAX) {
+		mse_err("invalid value. num=%u\n", data->num);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < data->num; i++) {
+		param = &data->dest[i].param;
+
+		if (param->vlan > MSE_CONFIG_VLAN_MAX)
+			goto wrong_value;
+
+		if (param->priority > MSE_CONFIG_PRIORITY_MAX)
+			goto wrong_value;
+
+		if (param->uniqueid > MSE_CONFIG_UNIQUEID_MAX)
+			goto wrong_value;
+
+		data->dest[i].device_name_tx[
+			sizeof(data->dest[i].device_name_tx) - 1] = '\0';
+	}
+
+	spin_lock_irqsave(&config->lock, flags);
+	config->avtp_tx_fanout = *data;
+	spin_unlock_irqrestore(&config->lock, flags);
+
+	return 0;
+
+wrong_value:
+	mse_err("invalid value. dest=%d vlan=%d, priority=%d, uniqueid=%d\n",
+		i, param->vlan, param->priority, param->uniqueid);
+
+	return -EINVAL;
+}
+
+int mse_config_get_avtp_tx_fanout(int index,
+				  struct mse_avtp_tx_fanout *data)
+{
+	struct mse_config *config;
+	unsigned long flags;
+
+	if ((index < 0) || (index >= MSE_ADAPTER_MEDIA_MAX)) {
+		mse_err("invalid argument. index=%d\n", index);
+		return -EINVAL;
+	}
+	config = mse_get_dev_config(index);
+
+	mse_debug("START\n");
+
+	spin_lock_irqsave(&config->lock, flags);
+	*data = config->avtp_tx_fanout;
+	spin_unlock_irqrestore(&config->lock, flags);
+
+	return 0;
+}
+
 int mse_config_set_avtp_rx_param(int index, struct mse_avtp_rx_param *data)
 {
 	struct mse_config *config;
@@ -522,6 +598,78 @@ int mse_config_get_media_mpeg2ts_config(int index,
 	return 0;
 }
 
+int mse_config_set_media_mpeg2ts_pid_filter(
+				int index,
+				struct mse_media_mpeg2ts_pid_filter *data)
+{
+	struct mse_config *config;
+	unsigned long flags;
+	int i;
+
+	if ((index < 0) || (index >= MSE_ADAPTER_MEDIA_MAX)) {
+		mse_err("invalid argument. index=%d\n", index);
+		return -EINVAL;
+	}
+	config = mse_get_dev_config(index);
+
+	if (config->info.type != MSE_STREAM_TYPE_MPEG2TS) {
+		mse_err("mse%d does not permit.\n", index);
+		return -EPERM;
+	}
+
+	if (mse_dev_is_busy(index)) {
+		mse_err("mse%d is running.\n", index);
+		return -EBUSY;
+	}
+
+	mse_debug("START\n");
+
+	if (data->num > MSE_CONFIG_PID_FILTER_MAX) {
+		mse_err("invalid value. num=%u\n", data->num);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < data->num; i++) {
+		if (data->pid[i] >= MSE_CONFIG_PCR_PID_MAX) {
+			mse_err("invalid value. pid=%u\n", data->pid[i]);
+			return -EINVAL;
+		}
+	}
+
+	spin_lock_irqsave(&config->lock, flags);
+	config->media_mpeg2ts_pid_filter = *data;
+	spin_unlock_irqrestore(&config->lock, flags);
+
+	return 0;
+}
+
+int mse_config_get_media_mpeg2ts_pid_filter(
+				int index,
+				struct mse_media_mpeg2ts_pid_filter *data)
+{
+	struct mse_config *config;
+	unsigned long flags;
+
+	if ((index < 0) || (index >= MSE_ADAPTER_MEDIA_MAX)) {
+		mse_err("invalid argument. index=%d\n", index);
+		return -EINVAL;
+	}
+	config = mse_get_dev_config(index);
+
+	if (config->info.type != MSE_STREAM_TYPE_MPEG2TS) {
+		mse_err("mse%d does not permit.\n", index);
+		return -EPERM;
+	}
+
+	mse_debug("START\n");
+
+	spin_lock_irqsave(&config->lock, flags);
+	*data = config->media_mpeg2ts_pid_filter;
+	spin_unlock_irqrestore(&config->lock, flags);
+
+	return 0;
+}
+
 int mse_config_set_ptp_config(int index, struct mse_ptp_config *data)
 {
 	struct mse_config *config;
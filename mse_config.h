@@ -77,11 +77,13 @@ struct mse_config {
 	struct mse_media_audio_config media_audio_config;
 	struct mse_media_video_config media_video_config;
 	struct mse_media_mpeg2ts_config media_mpeg2ts_config;
+	struct mse_media_mpeg2ts_pid_filter media_mpeg2ts_pid_filter;
 	struct mse_ptp_config ptp_config;
 	struct mse_mch_config mch_config;
 	struct mse_avtp_tx_param avtp_tx_param_crf;
 	struct mse_avtp_rx_param avtp_rx_param_crf;
 	struct mse_delay_time delay_time;
+	struct mse_avtp_tx_fanout avtp_tx_fanout;
 };
 
 int mse_dev_to_index(struct device *dev);
@@ -98,6 +100,10 @@ int mse_config_set_avtp_tx_param(int index,
 				 struct mse_avtp_tx_param *data);
 int mse_config_get_avtp_tx_param(int index,
 				 struct mse_avtp_tx_param *data);
+int mse_config_set_avtp_tx_fanout(int index,
+				  struct mse_avtp_tx_fanout *data);
+int mse_config_get_avtp_tx_fanout(int index,
+				  struct mse_avtp_tx_fanout *data);
 int mse_config_set_avtp_rx_param(int index,
 				 struct mse_avtp_rx_param *data);
 int mse_config_get_avtp_rx_param(int index,
@@ -114,6 +120,12 @@ int mse_config_set_media_mpeg2ts_config(int index,
 					struct mse_media_mpeg2ts_config *data);
 int mse_config_get_media_mpeg2ts_config(int index,
 					struct mse_media_mpeg2ts_config *data);
+int mse_config_set_media_mpeg2ts_pid_filter(
+				int index,
+				struct mse_media_mpeg2ts_pid_filter *data);
+int mse_config_get_media_mpeg2ts_pid_filter(
+				int index,
+				struct mse_media_mpeg2ts_pid_filter *data);
 int mse_config_set_ptp_config(int index, struct mse_ptp_config *data);
 int mse_config_get_ptp_config(int index, struct mse_ptp_config *data);
 int mse_config_set_mch_config(int index, struct mse_mch_config *data);
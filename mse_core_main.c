@@ -78,6 +78,9 @@
 #include <linux/list.h>
 #include <linux/dma-mapping.h>
 #include <linux/semaphore.h>
+#include <linux/idr.h>
+#include <linux/rcupdate.h>
+#include <linux/refcount.h>
 #include "avtp.h"
 #include "ravb_mse_kernel.h"
 #include "mse_packetizer.h"
@@ -120,6 +123,7 @@
 #define q_empty(que)            ((que)->head == (que)->tail)
 
 #define PTP_TIMESTAMPS_MAX   (512)
+#define MSE_CAPTURE_RING_SIZE (1024) /* power of 2, > PTP_TIMESTAMPS_MAX */
 #define PTP_TIMER_INTERVAL   (20 * 1000000)  /* 1/300 sec * 6 = 20ms */
 
 /* judge error 5% */
@@ -145,21 +149,36 @@
 #define MSE_DECODE_BUFFER_NUM (8)
 #define MSE_DECODE_BUFFER_NUM_START_MIN (2)
 #define MSE_DECODE_BUFFER_NUM_START_MAX (6)
-#define MAX_DECODE_SIZE       (8192) /* ALSA Period byte size */
 
-#define MSE_TRANS_BUF_NUM (3) /* size of transmission buffer array */
-#define MSE_TRANS_BUF_ACCEPTABLE (MSE_TRANS_BUF_NUM - 1)
+/* acceptable buffers by mse_start_transmission() */
+#define MSE_TRANS_BUF_ACCEPTABLE_DEFAULT (2)
+#define MSE_TRANS_BUF_ACCEPTABLE_MAX     (32)
 
-#define MSE_MPEG2TS_BUF_NUM  (MSE_TRANS_BUF_NUM)
-#define MSE_MPEG2TS_BUF_SIZE (512U * 1024U)
 #define MSE_MPEG2TS_BUF_THRESH (188U * 192U * 14U)
 
+/* CBS adapted to measured bitrate, peak of sliding windows */
+#define MSE_CBS_WINDOW_NS       (100 * 1000000)   /* 100 msec */
+#define MSE_CBS_WINDOW_NUM      (20)
+#define MSE_CBS_HYSTERESIS      (10)              /* percent to lower */
+
+/* intra-frame pacing of video, percent of frame interval */
+#define MSE_PACING_PERCENT_MAX  (100)
+#define MSE_PACING_SLACK_US     (20)
+
+/* default margin of launch time for the qdisc/driver to queue a packet */
+#define MSE_LAUNCH_TIME_LEAD_US_DEFAULT (300)
+
 #define mbit_to_bit(mbit)     (mbit * 1000000)
 
 #define MPEG2TS_TIMER_NS        (10000000)           /* 10 msec */
 
-/* (timer_ns * 90kHz) / 1e9 => (timer_ns * 9) / 1e5 */
-#define MPEG2TS_CLOCK_INC       ((MPEG2TS_TIMER_NS * 9) / 100000)
+/* (ns * 90kHz) / 1e9 => (ns * 9) / 1e5 */
+#define ns_to_90k(ns)           div_s64((s64)(ns) * 9, 100000)
+#define clk90k_to_ns(t)         div_s64((s64)(t) * 100000, 9)
+#define MPEG2TS_PLL_TAU_NS      (10000000000LL)      /* 10 sec */
+#define MPEG2TS_PLL_PPB_MAX     (100000)             /* 100ppm */
+#define MPEG2TS_PLL_DISCONT_NS  (1000000000LL)       /* 1 sec */
+#define MPEG2TS_RATE_WEIGHT     (8)
 
 #define MPEG2TS_TS_SIZE         (188)
 #define MPEG2TS_SYNC            (0x47)
@@ -168,6 +187,9 @@
 #define MPEG2TS_PCR90K_BITS     (33)
 #define MPEG2TS_PCR90K_INVALID  (BIT(MPEG2TS_PCR90K_BITS))
 #define MPEG2TS_PCR_PID_IGNORE  (MSE_CONFIG_PCR_PID_MAX)
+#define MPEG2TS_PID_MAX         (MSE_CONFIG_PCR_PID_MAX)
+#define MPEG2TS_SYNC_LOCK_COUNT (3)    /* sync bytes to lock */
+#define MPEG2TS_PCR_LOST_PACKETS (8192) /* packets without PCR of locked PID */
 
 #define atomic_dec_not_zero(v)  atomic_add_unless((v), -1, 0)
 
@@ -243,6 +265,24 @@ struct timestamp_reader {
 	struct timestamp_queue *que;
 };
 
+/**
+ * @brief CBS reservation adapted to measured bitrate
+ */
+struct mse_cbs_adapt {
+	/** @brief adapting is enabled */
+	bool f_enable;
+	/** @brief reservation by configured bitrate, upper bound */
+	struct mse_cbsparam max;
+	/** @brief bandwidth fraction currently set to network adapter */
+	u32 bandwidth_fraction;
+	/** @brief start time and sent bytes of current window */
+	u64 window_start;
+	u64 window_bytes;
+	/** @brief bitrate [bps] of recent windows */
+	u64 rates[MSE_CBS_WINDOW_NUM];
+	int pos;
+};
+
 struct mse_timing_ctrl {
 	u64 start_time;
 	u64 std_start_time;
@@ -255,6 +295,29 @@ struct mse_timing_ctrl {
 	bool f_ok;
 };
 
+/**
+ * @brief MPEG2-TS scanner state, kept across media buffers
+ */
+struct mpeg2ts_scanner {
+	/** @brief sync byte is locked */
+	bool f_locked;
+	/** @brief head of TS packet split at end of previous buffer */
+	u8 carry[MPEG2TS_M2TS_SIZE];
+	/** @brief valid bytes of carry */
+	int carry_len;
+	/** @brief TS packets since last PCR of locked PCR PID */
+	int pcr_lost;
+	/** @brief scanned bytes */
+	u64 bytes;
+	/** @brief last PCR and its byte position, for mux rate */
+	u64 pcr_90k;
+	u64 pcr_pos;
+	/** @brief estimated mux rate in bytes per second */
+	u64 rate;
+	/** @brief PIDs that carried PCR, for PCR PID auto detect */
+	DECLARE_BITMAP(pcr_pid_map, MPEG2TS_PID_MAX);
+};
+
 /** @brief transmission buffer */
 struct mse_trans_buffer {
 	/** @brief media buffer of adapter */
@@ -269,6 +332,10 @@ struct mse_trans_buffer {
 	void *private_data;
 	/** @brief callback function to media adapter */
 	int (*mse_completion)(void *priv, int size);
+	/** @brief PTP time of frame start, or of first byte (MPEG2-TS) */
+	u64 timestamp;
+	/** @brief data ends before frame end */
+	bool partial;
 
 	struct list_head list;
 };
@@ -277,6 +344,10 @@ struct mse_trans_buffer {
 struct mse_instance {
 	/** @brief instance used flag */
 	bool used_f;
+	/** @brief references by callers, one is held while opened */
+	refcount_t refs;
+	/** @brief last reference is released */
+	struct completion completion_release;
 
 	/** @brief wait for streaming stop */
 	struct completion completion_stop;
@@ -336,14 +407,20 @@ struct mse_instance {
 
 	/** @brief spin lock for buffer list */
 	spinlock_t lock_buf_list;
-	/** @brief array of transmission buffer */
-	struct mse_trans_buffer trans_buffer[MSE_TRANS_BUF_NUM];
+	/** @brief pool of transmission buffer */
+	struct mse_trans_buffer *trans_buffer;
+	/** @brief number of transmission buffer in pool */
+	int trans_buf_num;
+	/** @brief acceptable buffers by mse_start_transmission() */
+	int trans_buf_acceptable;
+	/** @brief buffers media adapter can have queued at most */
+	int trans_buf_depth;
+	/** @brief list of transmission buffer is not used */
+	struct list_head free_buf_list;
 	/** @brief list of transmission buffer is not completed */
 	struct list_head trans_buf_list;
 	/** @brief list of transmission buffer for core processing */
 	struct list_head proc_buf_list;
-	/** brief index of transmission buffer array */
-	int trans_idx;
 	/** brief count of buffers is not completed */
 	atomic_t trans_buf_cnt;
 	/** brief count of buffers is completed */
@@ -353,6 +430,19 @@ struct mse_instance {
 	struct hrtimer timer;
 	u64 timer_interval;
 
+	/** @brief time to spread packets of a video frame, 0 is off */
+	u64 pacing_ns;
+	/** @brief pacing of current frame, protected by lock_pacing */
+	spinlock_t lock_pacing;
+	u64 pacing_start;
+	u64 pacing_gap;
+	int pacing_sent;
+	/** @brief next media buffer starts a frame */
+	bool f_frame_start;
+
+	/** @brief network adapter schedules packets by launch time */
+	bool f_launch_time;
+
 	/** @brief spin lock for timer count */
 	spinlock_t lock_timer;
 
@@ -366,11 +456,19 @@ struct mse_instance {
 
 	/* @brief crf packetizer index */
 	int crf_index;
+	/** @brief timestamps per CRF AVTPDU */
+	int crf_tstamps_per_pdu;
+	/** @brief timestamps of a sent or received CRF AVTPDU */
+	u64 crf_tstamps[AVTP_CRF_TIMESTAMPS_MAX];
 	int crf_discont;
 
-	void *ptp_handle;
 	void *ptp_timer_handle;
 	void *mch_handle;
+	/* @brief shared capture and its read position */
+	struct mse_capture_hub *capture_hub;
+	u32 ptp_capture_pos;
+	/** @brief copy of capture ring entries being read */
+	u64 capture_tstamps[PTP_TIMESTAMPS_MAX];
 	int ptp_index;
 	int mch_index;
 
@@ -404,6 +502,10 @@ struct mse_instance {
 	bool f_depacketizing;
 	bool f_completion;
 	bool f_trans_start;
+	/** @brief buffer in completion callback ends a frame */
+	bool f_frame_end;
+	/** @brief previous transmission buffer ended before frame end */
+	bool f_frame_continue;
 	bool f_work_timestamp;
 	bool f_wait_start_transmission;
 
@@ -415,6 +517,9 @@ struct mse_instance {
 	/** @brief timing control */
 	struct mse_timing_ctrl timing_ctrl;
 
+	/** @brief CBS adapted to measured bitrate */
+	struct mse_cbs_adapt cbs_adapt;
+
 	/** @brief network configuration */
 	struct mse_network_config net_config;
 	struct mse_network_config crf_net_config;
@@ -448,30 +553,63 @@ struct mse_instance {
 	bool f_crf_sending;
 
 	/** @brief media clock recovery work */
-	u64 timestamps[PTP_TIMESTAMPS_MAX];
 	struct mch_timestamp ts[PTP_TIMESTAMPS_MAX];
 
+	/** @brief media clock recovery statistics */
+	u64 mch_stats_cycles;
+	u64 mch_stats_time_total;
+	u64 mch_stats_time_max;
+
 	/** @brief mpeg2ts buffer  */
 	u64 mpeg2ts_pcr_90k;
 	u64 mpeg2ts_clock_90k;
 	int mpeg2ts_pre_pcr_pid;
 	u64 mpeg2ts_pre_pcr_90k;
-	struct mse_trans_buffer mpeg2ts_buffer[MSE_MPEG2TS_BUF_NUM];
-	u8 *mpeg2ts_buffer_base;
-	int mpeg2ts_buffer_idx;
+	struct mpeg2ts_scanner mpeg2ts_scan;
+	/** @brief PCR locked clock, anchored to PTP time */
+	u64 mpeg2ts_clock_base_90k;
+	u64 mpeg2ts_clock_base_ns;
+	s64 mpeg2ts_clock_ppb;
+	s64 mpeg2ts_clock_lead_ref;
+	/* @brief media buffers held until PCR gate opens */
+	int mpeg2ts_held_cnt;
+	size_t mpeg2ts_held_size;
 
 	/** @brief audio buffer  */
 	int temp_w;
 	int temp_r;
-	unsigned char temp_buffer[MSE_DECODE_BUFFER_NUM][MAX_DECODE_SIZE];
+	unsigned char *temp_buffer[MSE_DECODE_BUFFER_NUM];
 	size_t temp_len[MSE_DECODE_BUFFER_NUM];
+	/** @brief size of each audio buffer, sized by period */
+	size_t temp_buffer_size;
 
 	/** @brief debug */
 	size_t processed;
 };
 
 static int mse_instance_max = MSE_INSTANCE_MAX;
-DEFINE_SPINLOCK(packetizer_crf_lock);
+static DEFINE_MUTEX(packetizer_crf_lock);
+
+/**
+ * @brief PTP capture shared by instances on the same capture channel
+ */
+struct mse_capture_hub {
+	int refcount;
+	int ptp_index;
+	int device;
+	int ch;
+	int freq;
+	void *ptp_handle;
+
+	/** @brief capture ring of PTP driver, or local_ring */
+	struct mse_ptp_capture_ring *ring;
+
+	/** @brief mutex for polling PTP driver into local_ring */
+	struct mutex lock;
+	struct mse_ptp_capture_ring local_ring;
+	u64 local_timestamps[MSE_CAPTURE_RING_SIZE];
+	u64 timestamps[PTP_TIMESTAMPS_MAX];
+};
 
 struct mse_device {
 	/** @brief device */
@@ -485,20 +623,90 @@ struct mse_device {
 
 	struct mse_adapter_network_ops *network_table[MSE_ADAPTER_NETWORK_MAX];
 	struct mse_adapter media_table[MSE_ADAPTER_MEDIA_MAX];
-	struct mse_instance instance_table[MSE_INSTANCE_MAX];
+	/** @brief opened instances, updated under mutex_open, read by RCU */
+	struct idr instance_idr;
+	struct kmem_cache *instance_cache;
 	struct mse_ptp_ops *ptp_table[MSE_PTP_MAX];
 	struct mch_ops *mch_table[MSE_MCH_MAX];
+
+	/** @brief mutex lock for capture hub table */
+	struct mutex mutex_capture_hub;
+	struct mse_capture_hub *capture_hub_table[MSE_INSTANCE_MAX];
 };
 
 /* MSE device data */
 static struct mse_device *mse;
 
+/* take reference of opened instance, mse_close() waits for its put */
+static struct mse_instance *mse_instance_get(int index)
+{
+	struct mse_instance *instance;
+
+	rcu_read_lock();
+	instance = idr_find(&mse->instance_idr, index);
+	if (instance && !refcount_inc_not_zero(&instance->refs))
+		instance = NULL;
+	rcu_read_unlock();
+
+	return instance;
+}
+
+static void mse_instance_put(struct mse_instance *instance)
+{
+	if (refcount_dec_and_test(&instance->refs))
+		complete(&instance->completion_release);
+}
+
 /*
  * module parameters
  */
 static int major;
 module_param(major, int, 0440);
 
+static bool mch_stats;
+module_param(mch_stats, bool, 0644);
+MODULE_PARM_DESC(mch_stats, "Report media clock recovery cost at close");
+
+static int trans_buffers = MSE_TRANS_BUF_ACCEPTABLE_DEFAULT;
+module_param(trans_buffers, int, 0440);
+MODULE_PARM_DESC(trans_buffers,
+		 "Number of media buffers an adapter can queue ahead (1-32)");
+
+static bool cbs_adaptive;
+module_param(cbs_adaptive, bool, 0440);
+MODULE_PARM_DESC(cbs_adaptive,
+		 "Adapt CBS of video and MPEG2-TS to measured bitrate");
+
+static int cbs_adaptive_headroom = 20;
+module_param(cbs_adaptive_headroom, int, 0440);
+MODULE_PARM_DESC(cbs_adaptive_headroom,
+		 "Reservation over measured peak bitrate in percent");
+
+static int cbs_adaptive_floor = 25;
+module_param(cbs_adaptive_floor, int, 0440);
+MODULE_PARM_DESC(cbs_adaptive_floor,
+		 "Lower bound in percent of configured reservation");
+
+static int video_pacing;
+module_param(video_pacing, int, 0440);
+MODULE_PARM_DESC(video_pacing,
+		 "Spread video frame over percent of frame interval (0: off)");
+
+static int crf_timestamps_per_pdu;
+module_param(crf_timestamps_per_pdu, int, 0440);
+MODULE_PARM_DESC(crf_timestamps_per_pdu,
+		 "Timestamps per CRF AVTPDU (0: 1 with ptp, 6 with capture)");
+
+static bool launch_time;
+module_param(launch_time, bool, 0440);
+MODULE_PARM_DESC(launch_time,
+		 "Schedule TX packets by AVTP time if adapter supports it");
+
+static int launch_time_lead_us = MSE_LAUNCH_TIME_LEAD_US_DEFAULT;
+module_param(launch_time_lead_us, int, 0440);
+MODULE_PARM_DESC(launch_time_lead_us,
+		 "Minimum launch time ahead of packetize time [us]");
+
 /*
  * function prototypes
  */
@@ -785,7 +993,7 @@ static int mse_delete_config_device(int index_media)
 
 static int mse_get_default_config(int index, struct mse_instance *instance)
 {
-	int ret = 0, err;
+	int ret = 0, err, i;
 	struct mse_network_config *network = &instance->net_config;
 	struct mse_network_config *crf_network = &instance->crf_net_config;
 	struct mse_video_config *video = &instance->media_config.video;
@@ -795,6 +1003,7 @@ static int mse_get_default_config(int index, struct mse_instance *instance)
 	struct mse_avtp_rx_param avtp_rx_param;
 	struct mse_media_video_config video_config;
 	struct mse_media_mpeg2ts_config mpeg2ts_config;
+	struct mse_media_mpeg2ts_pid_filter pid_filter;
 	struct mse_media_audio_config audio_config;
 	struct mse_ptp_config ptp_config;
 	struct mse_mch_config mch_config;
@@ -851,6 +1060,15 @@ static int mse_get_default_config(int index, struct mse_instance *instance)
 			mpeg2ts_config.tspackets_per_frame;
 		mpeg2ts->bitrate = mpeg2ts_config.bitrate;
 		mpeg2ts->pcr_pid = mpeg2ts_config.pcr_pid;
+		err = mse_config_get_media_mpeg2ts_pid_filter(index,
+							      &pid_filter);
+		if (err < 0) {
+			mse_err("undefined media_mpeg2ts_pid_filter\n");
+			ret = -EPERM;
+		}
+		mpeg2ts->pid_filter_num = pid_filter.num;
+		for (i = 0; i < pid_filter.num; i++)
+			mpeg2ts->pid_filter[i] = pid_filter.pid[i];
 		err = mse_config_get_delay_time(index,
 						&delay_time);
 		instance->max_transit_time_ns = delay_time.max_transit_time_ns;
@@ -923,6 +1141,7 @@ static struct mse_ptp_ops mse_ptp_ops_dummy = {
 	.capture_start = mse_ptp_capture_start_dummy,
 	.capture_stop = mse_ptp_capture_stop_dummy,
 	.get_timestamps = mse_ptp_get_timestamps_dummy,
+	.capture_ring_get = mse_ptp_capture_ring_get_dummy,
 	.timer_open = mse_ptp_timer_open_dummy,
 	.timer_close = mse_ptp_timer_close_dummy,
 	.timer_start = mse_ptp_timer_start_dummy,
@@ -996,6 +1215,17 @@ static int mse_ptp_get_timestamps(int index,
 				     timestamps);
 }
 
+static struct mse_ptp_capture_ring *mse_ptp_capture_ring_get(int index,
+							    void *ptp_handle)
+{
+	struct mse_ptp_ops *p_ops = mse_ptp_find_ops(index);
+
+	if (!p_ops->capture_ring_get)
+		return NULL;
+
+	return p_ops->capture_ring_get(ptp_handle);
+}
+
 static void *mse_ptp_timer_open(int index, u32 (*handler)(void *priv),
 				void *priv)
 {
@@ -1025,22 +1255,190 @@ static int mse_ptp_timer_cancel(int index, void *timer_handle)
 	return p_ops->timer_cancel(timer_handle);
 }
 
-static void callback_completion(struct mse_trans_buffer *buf, int size)
+/*
+ * PTP capture hub, shares one capture stream between instances
+ */
+static inline u64 capture_ring_entry(struct mse_ptp_capture_ring *ring,
+				     u32 pos)
+{
+	return ring->timestamps[pos & (ring->size - 1)];
+}
+
+static struct mse_capture_hub *mse_capture_hub_get(int ptp_index,
+						   int device,
+						   int ch,
+						   int freq)
+{
+	struct mse_capture_hub *hub;
+	int i, empty = -1;
+	int ret;
+
+	mutex_lock(&mse->mutex_capture_hub);
+
+	for (i = 0; i < ARRAY_SIZE(mse->capture_hub_table); i++) {
+		hub = mse->capture_hub_table[i];
+		if (!hub) {
+			if (empty < 0)
+				empty = i;
+			continue;
+		}
+
+		if (hub->ptp_index == ptp_index && hub->device == device &&
+		    hub->ch == ch && hub->freq == freq) {
+			hub->refcount++;
+			mutex_unlock(&mse->mutex_capture_hub);
+
+			return hub;
+		}
+	}
+
+	if (empty < 0) {
+		mutex_unlock(&mse->mutex_capture_hub);
+		mse_err("capture hub table is full\n");
+
+		return NULL;
+	}
+
+	hub = kzalloc(sizeof(*hub), GFP_KERNEL);
+	if (!hub) {
+		mutex_unlock(&mse->mutex_capture_hub);
+
+		return NULL;
+	}
+
+	hub->ptp_index = ptp_index;
+	hub->device = device;
+	hub->ch = ch;
+	hub->freq = freq;
+	mutex_init(&hub->lock);
+
+	/* ptp open */
+	hub->ptp_handle = mse_ptp_open(ptp_index);
+	if (!hub->ptp_handle) {
+		mse_err("cannot mse_ptp_open()\n");
+		goto error_cannot_open_ptp;
+	}
+
+	mse_info("mse_ptp_capture_start %d %p %d %zu\n",
+		 ptp_index, hub->ptp_handle, ch,
+		 ARRAY_SIZE(hub->timestamps));
+
+	ret = mse_ptp_capture_start(ptp_index, hub->ptp_handle, ch,
+				    ARRAY_SIZE(hub->timestamps));
+	if (ret < 0) {
+		mse_err("cannot mse_ptp_capture_start()\n");
+		goto error_cannot_ptp_capture_start;
+	}
+
+	/* use capture ring of PTP driver, if supported */
+	hub->ring = mse_ptp_capture_ring_get(ptp_index, hub->ptp_handle);
+	if (!hub->ring) {
+		hub->local_ring.size = ARRAY_SIZE(hub->local_timestamps);
+		hub->local_ring.timestamps = hub->local_timestamps;
+		hub->ring = &hub->local_ring;
+	}
+
+	hub->refcount = 1;
+	mse->capture_hub_table[empty] = hub;
+
+	mutex_unlock(&mse->mutex_capture_hub);
+
+	return hub;
+
+error_cannot_ptp_capture_start:
+	mse_ptp_close(ptp_index, hub->ptp_handle);
+
+error_cannot_open_ptp:
+	kfree(hub);
+	mutex_unlock(&mse->mutex_capture_hub);
+
+	return NULL;
+}
+
+static void mse_capture_hub_put(struct mse_capture_hub *hub)
+{
+	int i;
+
+	mutex_lock(&mse->mutex_capture_hub);
+
+	if (--hub->refcount > 0) {
+		mutex_unlock(&mse->mutex_capture_hub);
+		return;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(mse->capture_hub_table); i++)
+		if (mse->capture_hub_table[i] == hub)
+			mse->capture_hub_table[i] = NULL;
+
+	mutex_unlock(&mse->mutex_capture_hub);
+
+	if (mse_ptp_capture_stop(hub->ptp_index, hub->ptp_handle) < 0)
+		mse_err("cannot mse_ptp_capture_stop()\n");
+
+	if (mse_ptp_close(hub->ptp_index, hub->ptp_handle) < 0)
+		mse_err("cannot mse_ptp_close()\n");
+
+	kfree(hub);
+}
+
+static void mse_capture_hub_update(struct mse_capture_hub *hub)
+{
+	struct mse_ptp_capture_ring *ring = &hub->local_ring;
+	int ret, i;
+
+	/* PTP driver fills the ring directly */
+	if (hub->ring != ring)
+		return;
+
+	/* process context only, PTP driver may sleep */
+	mutex_lock(&hub->lock);
+
+	ret = mse_ptp_get_timestamps(hub->ptp_index,
+				     hub->ptp_handle,
+				     ARRAY_SIZE(hub->timestamps),
+				     hub->timestamps);
+	if (ret < 0)
+		mse_warn("could not get timestamps ret=%d\n", ret);
+
+	for (i = 0; i < ret; i++) {
+		ring->timestamps[ring->head & (ring->size - 1)] =
+			hub->timestamps[i];
+		smp_store_release(&ring->head, ring->head + 1);
+	}
+
+	mutex_unlock(&hub->lock);
+}
+
+static void callback_completion(struct mse_instance *instance,
+				struct mse_trans_buffer *buf,
+				int size)
 {
+	int (*mse_completion)(void *priv, int size) = buf->mse_completion;
+	void *priv = buf->private_data;
+	unsigned long flags;
+
 	mse_debug("buf=%p media_buffer=%p buffer=%p buffer_size=%zu callback=%p private=%p size=%d\n",
 		  buf, buf->media_buffer, buf->buffer, buf->buffer_size,
 		  buf->mse_completion, buf->private_data, size);
 
-	list_del(&buf->list);
-
-	if (buf->mse_completion)
-		buf->mse_completion(buf->private_data, size);
-
 	buf->buffer_size = 0;
 	buf->work_length = 0;
 	buf->media_buffer = NULL;
 	buf->private_data = NULL;
 	buf->mse_completion = NULL;
+	buf->timestamp = 0;
+
+	/* read by mse_is_frame_end() in callback */
+	instance->f_frame_end = !buf->partial;
+	buf->partial = false;
+
+	/* back to pool before callback, adapter may queue next buffer */
+	spin_lock_irqsave(&instance->lock_buf_list, flags);
+	list_move_tail(&buf->list, &instance->free_buf_list);
+	spin_unlock_irqrestore(&instance->lock_buf_list, flags);
+
+	if (mse_completion)
+		mse_completion(priv, size);
 }
 
 static void mse_trans_complete(struct mse_instance *instance, int size)
@@ -1055,7 +1453,7 @@ static void mse_trans_complete(struct mse_instance *instance, int size)
 
 		mse_debug("total processed=%zu\n", instance->processed);
 		atomic_dec(&instance->trans_buf_cnt);
-		callback_completion(buf, size);
+		callback_completion(instance, buf, size);
 	}
 }
 
@@ -1065,15 +1463,176 @@ static void mse_free_all_trans_buffers(struct mse_instance *instance, int size)
 
 	/* free all buf from DONE buf list */
 	list_for_each_entry_safe(buf, buf1, &instance->proc_buf_list, list)
-		callback_completion(buf, size);
+		callback_completion(instance, buf, size);
 	atomic_set(&instance->done_buf_cnt, 0);
 
 	/* free all buf from TRANS buf list */
 	list_for_each_entry_safe(buf, buf1, &instance->trans_buf_list, list)
-		callback_completion(buf, size);
+		callback_completion(instance, buf, size);
 	atomic_set(&instance->trans_buf_cnt, 0);
 }
 
+/* set CBS of main stream and of its fan-out destinations */
+static int mse_network_set_cbs_param(struct mse_instance *instance,
+				     struct mse_cbsparam *cbs)
+{
+	struct mse_packet_ctrl *dma = instance->packet_buffer;
+	int i, ret;
+
+	ret = instance->network->set_cbs_param(instance->index_network, cbs);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; dma && i < dma->fanout_num; i++) {
+		ret = dma->fanout[i].ops->set_cbs_param(dma->fanout[i].index,
+							cbs);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+static void mse_cbs_adapt_init(struct mse_instance *instance,
+			       struct mse_cbsparam *cbs)
+{
+	struct mse_cbs_adapt *adapt = &instance->cbs_adapt;
+
+	memset(adapt, 0, sizeof(*adapt));
+	adapt->f_enable = cbs_adaptive;
+	adapt->max = *cbs;
+	adapt->bandwidth_fraction = cbs->bandwidth_fraction;
+}
+
+static void mse_cbs_adapt_update(struct mse_instance *instance)
+{
+	struct mse_cbs_adapt *adapt = &instance->cbs_adapt;
+	u64 port_rate = instance->net_config.port_transmit_rate;
+	u64 sent_bytes = instance->packet_buffer->sent_bytes;
+	u64 now, elapsed, peak, bits, frac, frac_min;
+	struct mse_cbsparam cbs;
+	int i, ret;
+
+	if (!adapt->f_enable || !port_rate)
+		return;
+
+	now = ktime_get_ns();
+	if (!adapt->window_start) {
+		adapt->window_start = now;
+		adapt->window_bytes = sent_bytes;
+		return;
+	}
+
+	elapsed = now - adapt->window_start;
+	if (elapsed < MSE_CBS_WINDOW_NS)
+		return;
+
+	adapt->rates[adapt->pos] = div64_u64((sent_bytes -
+					      adapt->window_bytes) *
+					     BITS_PER_BYTE * NSEC_SCALE,
+					     elapsed);
+	adapt->pos = (adapt->pos + 1) % MSE_CBS_WINDOW_NUM;
+	adapt->window_start = now;
+	adapt->window_bytes = sent_bytes;
+
+	peak = 0;
+	for (i = 0; i < MSE_CBS_WINDOW_NUM; i++)
+		peak = max(peak, adapt->rates[i]);
+
+	/* target reservation, within floor and configured */
+	bits = div_u64(peak * (100 + max(cbs_adaptive_headroom, 0)), 100);
+	frac = div64_u64((u64)UINT_MAX * min(bits, port_rate), port_rate);
+	frac_min = div_u64((u64)adapt->max.bandwidth_fraction *
+			   clamp(cbs_adaptive_floor, 0, 100), 100);
+	frac = clamp_t(u64, frac, frac_min, adapt->max.bandwidth_fraction);
+
+	/* raise at once, lower beyond hysteresis only */
+	if (frac <= adapt->bandwidth_fraction &&
+	    frac * 100 >= (u64)adapt->bandwidth_fraction *
+			  (100 - MSE_CBS_HYSTERESIS))
+		return;
+
+	if (frac == adapt->max.bandwidth_fraction) {
+		cbs = adapt->max;
+	} else {
+		memset(&cbs, 0, sizeof(cbs));
+		ret = mse_packetizer_calc_cbs(frac, UINT_MAX, &cbs);
+		if (ret < 0)
+			return;
+	}
+
+	ret = mse_network_set_cbs_param(instance, &cbs);
+	if (ret < 0) {
+		mse_err("cannot set cbs param ret=%d\n", ret);
+		return;
+	}
+
+	mse_debug("peak=%llu bps bandwidth fraction %08x -> %08x\n",
+		  peak, adapt->bandwidth_fraction, cbs.bandwidth_fraction);
+	adapt->bandwidth_fraction = cbs.bandwidth_fraction;
+}
+
+static void mse_pacing_start(struct mse_instance *instance, size_t size)
+{
+	struct mse_video_config *video = &instance->media_config.video;
+	int payload = video->bytes_per_frame ?
+		      video->bytes_per_frame : AVTP_PAYLOAD_MAX;
+	unsigned long flags;
+
+	spin_lock_irqsave(&instance->lock_pacing, flags);
+	instance->pacing_start = ktime_get_ns();
+	/* size 0 stops pacing until next frame */
+	instance->pacing_gap = size ? div_u64(instance->pacing_ns,
+					      DIV_ROUND_UP(size, payload)) : 0;
+	instance->pacing_sent = 0;
+	spin_unlock_irqrestore(&instance->lock_pacing, flags);
+}
+
+/* wait for slot of next packet, return packets allowed to send now */
+static int mse_pacing_wait(struct mse_instance *instance)
+{
+	u64 now, slot, wait_us;
+	unsigned long flags;
+	int count;
+
+	spin_lock_irqsave(&instance->lock_pacing, flags);
+	if (!instance->pacing_gap) {
+		spin_unlock_irqrestore(&instance->lock_pacing, flags);
+		return MSE_TX_PACKET_NUM;
+	}
+
+	slot = instance->pacing_start +
+		instance->pacing_gap * instance->pacing_sent;
+	spin_unlock_irqrestore(&instance->lock_pacing, flags);
+
+	now = ktime_get_ns();
+	if (slot > now) {
+		wait_us = div_u64(slot - now, NSEC_PER_USEC);
+		usleep_range(wait_us, wait_us + MSE_PACING_SLACK_US);
+		now = ktime_get_ns();
+	}
+
+	spin_lock_irqsave(&instance->lock_pacing, flags);
+	if (instance->pacing_gap && now > instance->pacing_start)
+		count = div64_u64(now - instance->pacing_start,
+				  instance->pacing_gap) + 1 -
+			instance->pacing_sent;
+	else
+		count = MSE_TX_PACKET_NUM;
+	spin_unlock_irqrestore(&instance->lock_pacing, flags);
+
+	return clamp(count, 1, MSE_TX_PACKET_NUM);
+}
+
+static void mse_pacing_sent(struct mse_instance *instance, int sent)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&instance->lock_pacing, flags);
+	instance->pacing_sent += sent;
+	spin_unlock_irqrestore(&instance->lock_pacing, flags);
+}
+
 static void mse_work_stream(struct work_struct *work)
 {
 	struct mse_instance *instance;
@@ -1104,17 +1663,23 @@ static void mse_work_stream(struct work_struct *work)
 		/* while data is remained */
 		do {
 			/* request send packet */
-			err = mse_packet_ctrl_send_packet(index_network,
-							  packet_buffer,
-							  network);
+			err = mse_packet_ctrl_send_packet(
+				index_network,
+				mse_pacing_wait(instance),
+				packet_buffer,
+				network);
 
 			if (err < 0) {
 				mse_err("send error %d\n", err);
 				break;
 			}
 
+			mse_pacing_sent(instance, err);
+
 			wake_up_interruptible(&instance->wait_wk_stream);
 		} while (mse_packet_ctrl_check_packet_remain(packet_buffer));
+
+		mse_cbs_adapt_update(instance);
 	} else {
 		/* while state is RUNNABLE */
 		while (mse_state_test(instance, MSE_STATE_RUNNABLE)) {
@@ -1687,7 +2252,20 @@ static void mse_work_timestamp(struct work_struct *work)
 
 	if (instance->f_mch_enable) {
 		/* mch */
-		media_clock_recovery(instance);
+		if (mch_stats) {
+			u64 start, elapsed;
+
+			start = ktime_get_ns();
+			media_clock_recovery(instance);
+			elapsed = ktime_get_ns() - start;
+
+			instance->mch_stats_cycles++;
+			instance->mch_stats_time_total += elapsed;
+			if (elapsed > instance->mch_stats_time_max)
+				instance->mch_stats_time_max = elapsed;
+		} else {
+			media_clock_recovery(instance);
+		}
 	}
 
 	instance->f_work_timestamp = false;
@@ -1758,11 +2336,10 @@ static int mse_initialize_crf_packetizer(struct mse_instance *instance)
 	struct mse_audio_config config;
 	struct mse_cbsparam cbs;
 	int ret;
-	unsigned long flags;
 
-	spin_lock_irqsave(&packetizer_crf_lock, flags);
+	mutex_lock(&packetizer_crf_lock);
 	ret = instance->crf_index = crf->open();
-	spin_unlock_irqrestore(&packetizer_crf_lock, flags);
+	mutex_unlock(&packetizer_crf_lock);
 	if (instance->crf_index < 0) {
 		mse_err("cannot open packetizer ret=%d\n", ret);
 		return instance->crf_index;
@@ -1772,6 +2349,17 @@ static int mse_initialize_crf_packetizer(struct mse_instance *instance)
 	crf->set_network_config(instance->crf_index,
 				&instance->crf_net_config);
 
+	/* timestamps per CRF AVTPDU, up to MTU */
+	if (crf_timestamps_per_pdu > 0)
+		instance->crf_tstamps_per_pdu =
+			min_t(int, crf_timestamps_per_pdu,
+			      AVTP_CRF_TIMESTAMPS_MAX);
+	else if (!instance->f_ptp_capture)
+		instance->crf_tstamps_per_pdu = CRF_PTP_TIMESTAMPS;
+	else
+		instance->crf_tstamps_per_pdu = CRF_AUDIO_TIMESTAMPS;
+	config.crf_timestamps_per_pdu = instance->crf_tstamps_per_pdu;
+
 	/* base_frequency */
 	config.sample_rate = audio->sample_rate;
 	/* timestamp_interval */
@@ -1811,10 +2399,10 @@ error_set_streamid_fail:
 error_set_cbs_param_fail:
 error_calc_cbs_fail:
 error_set_audio_config_fail:
-	spin_lock_irqsave(&packetizer_crf_lock, flags);
+	mutex_lock(&packetizer_crf_lock);
 	crf->release(instance->crf_index);
 	instance->crf_index = MSE_INDEX_UNDEFINED;
-	spin_unlock_irqrestore(&packetizer_crf_lock, flags);
+	mutex_unlock(&packetizer_crf_lock);
 
 	return ret;
 }
@@ -1822,12 +2410,11 @@ error_set_audio_config_fail:
 static void mse_release_crf_packetizer(struct mse_instance *instance)
 {
 	struct mse_packetizer_ops *crf = &mse_packetizer_crf_tstamp_audio_ops;
-	unsigned long flags;
 
 	if (instance->crf_index >= 0) {
-		spin_lock_irqsave(&packetizer_crf_lock, flags);
+		mutex_lock(&packetizer_crf_lock);
 		crf->release(instance->crf_index);
-		spin_unlock_irqrestore(&packetizer_crf_lock, flags);
+		mutex_unlock(&packetizer_crf_lock);
 	}
 }
 
@@ -1846,6 +2433,7 @@ static void mse_work_packetize(struct work_struct *work)
 	int trans_size;
 	unsigned long flags;
 	struct mse_trans_buffer *buf;
+	u64 now;
 
 	instance = container_of(work, struct mse_instance, wk_packetize);
 	mse_debug_state(instance);
@@ -1860,6 +2448,10 @@ static void mse_work_packetize(struct work_struct *work)
 	if (!buf)
 		return; /* skip work */
 
+	/* media buffer is held for PCR */
+	if (!buf->buffer)
+		return; /* skip work */
+
 	trans_size = buf->buffer_size - buf->work_length;
 	mse_debug("trans size=%d buffer=%p buffer_size=%zu\n",
 		  trans_size, buf->buffer, buf->buffer_size);
@@ -1874,12 +2466,28 @@ static void mse_work_packetize(struct work_struct *work)
 		return;
 	}
 
+	if (!buf->work_length) {
+		/*
+		 * spread packets of whole video frame over frame interval,
+		 * frame sent in parts is not paced, its size is unknown
+		 */
+		if (instance->pacing_ns && instance->f_frame_start)
+			mse_pacing_start(instance,
+					 buf->partial ? 0 : buf->buffer_size);
+		instance->f_frame_start = !buf->partial;
+	}
+
+	/* next buffer may be started, take frame info from this buffer */
+	if (instance->packetizer->set_frame_end)
+		instance->packetizer->set_frame_end(instance->index_packetizer,
+						    !buf->partial);
+
 	/* make AVTP packet with one timestamp */
 	if (!IS_MSE_TYPE_AUDIO(instance->media->type)) {
 		instance->avtp_timestamps_current = 0;
 		instance->avtp_timestamps_size = 1;
 		instance->avtp_timestamps[0] =
-			instance->timestamp + instance->max_transit_time_ns;
+			buf->timestamp + instance->max_transit_time_ns;
 	}
 
 	while (buf->work_length < buf->buffer_size) {
@@ -1903,6 +2511,13 @@ static void mse_work_packetize(struct work_struct *work)
 			}
 		}
 
+		if (instance->f_launch_time) {
+			mse_ptp_get_time(instance->ptp_index, &now);
+			instance->packet_buffer->launch_now = now;
+			instance->packet_buffer->launch_offset =
+				instance->max_transit_time_ns;
+		}
+
 		ret = mse_packet_ctrl_make_packet(
 					instance->index_packetizer,
 					buf->buffer,
@@ -1984,7 +2599,8 @@ static void mse_work_packetize(struct work_struct *work)
 		if (ret != -EAGAIN)
 			atomic_inc(&instance->done_buf_cnt);
 
-		if (!instance->timer_interval)
+		/* frame timer paces the last part of frame only */
+		if (!instance->timer_interval || buf->partial)
 			queue_work(instance->wq_packet, &instance->wk_callback);
 	}
 }
@@ -2154,6 +2770,15 @@ static void mse_work_depacketize(struct work_struct *work)
 
 	switch (instance->media->type) {
 	case MSE_TYPE_ADAPTER_AUDIO:
+		/* media buffer larger than period is not acceptable */
+		if (buf->buffer_size > instance->temp_buffer_size) {
+			mse_err("buffer_size=%zu over period size=%zu\n",
+				buf->buffer_size, instance->temp_buffer_size);
+			instance->f_trans_start = false;
+			mse_trans_complete(instance, -EINVAL);
+			break;
+		}
+
 		/* get AVTP packet payload */
 		audio = &instance->media_config.audio;
 		while (received) {
@@ -2171,7 +2796,8 @@ static void mse_work_depacketize(struct work_struct *work)
 				&t_stored,
 				packet_buffer,
 				instance->packetizer,
-				&instance->temp_len[instance->temp_w]);
+				&instance->temp_len[instance->temp_w],
+				NULL);
 			if (ret < 0) {
 				if (ret != -EAGAIN) {
 					instance->f_trans_start = false;
@@ -2249,7 +2875,8 @@ static void mse_work_depacketize(struct work_struct *work)
 						&t_stored,
 						packet_buffer,
 						instance->packetizer,
-						&buf->work_length);
+						&buf->work_length,
+						&buf->partial);
 
 		/* complete callback */
 		if (ret > 0) {
@@ -2294,6 +2921,22 @@ static void mse_work_depacketize(struct work_struct *work)
 		instance->f_depacketizing = false;
 }
 
+/*
+ * restart timer earlier than its interval. State is tested under
+ * lock_state, so it does not race with hrtimer_cancel() done after
+ * the state left EXECUTE in mse_stop_streaming_common().
+ */
+static void mse_timer_rearm(struct mse_instance *instance, u64 wait)
+{
+	unsigned long flags;
+
+	read_lock_irqsave(&instance->lock_state, flags);
+	if (mse_state_test_nolock(instance, MSE_STATE_EXECUTE))
+		hrtimer_start(&instance->timer, ns_to_ktime(wait),
+			      HRTIMER_MODE_REL);
+	read_unlock_irqrestore(&instance->lock_state, flags);
+}
+
 static void mse_work_callback(struct work_struct *work)
 {
 	struct mse_instance *instance;
@@ -2336,8 +2979,12 @@ static void mse_work_callback(struct work_struct *work)
 
 	if (instance->tx) {
 		if (IS_MSE_TYPE_MPEG2TS(adapter->type)) {
-			u64 clock_90k = instance->mpeg2ts_clock_90k;
+			u64 clock_90k, now;
 			u64 pcr_90k = instance->mpeg2ts_pcr_90k;
+			u64 wait;
+
+			mse_ptp_get_time(instance->ptp_index, &now);
+			clock_90k = mpeg2ts_clock_update(instance, now);
 
 			/* state is NOT STOPPING */
 			if (!mse_state_test(instance, MSE_STATE_STOPPING)) {
@@ -2345,8 +2992,16 @@ static void mse_work_callback(struct work_struct *work)
 					mse_debug("mpeg2ts_clock_90k time=%llu pcr=%llu\n",
 						  clock_90k, pcr_90k);
 
-					if (compare_pcr(pcr_90k, clock_90k))
+					if (compare_pcr(pcr_90k, clock_90k)) {
+						/* wake up just after PCR */
+						wait = clk90k_to_ns(
+							((pcr_90k - clock_90k) &
+							 (BIT(MPEG2TS_PCR90K_BITS) - 1)) + 1);
+						if (wait < instance->timer_interval)
+							mse_timer_rearm(instance,
+									wait);
 						return;
+					}
 				}
 			}
 		}
@@ -2413,6 +3068,13 @@ static void mse_work_callback(struct work_struct *work)
 		}
 	}
 
+	/* next period submitted together, start it */
+	spin_lock_irqsave(&instance->lock_buf_list, flags);
+	if (list_empty(&instance->proc_buf_list) &&
+	    !list_empty(&instance->trans_buf_list))
+		queue_work(instance->wq_packet, &instance->wk_start_trans);
+	spin_unlock_irqrestore(&instance->lock_buf_list, flags);
+
 	if (!atomic_read(&instance->trans_buf_cnt)) {
 		/* state is STOPPING */
 		if (mse_state_test(instance, MSE_STATE_STOPPING)) {
@@ -2562,9 +3224,6 @@ static enum hrtimer_restart mse_timer_callback(struct hrtimer *arg)
 		return HRTIMER_NORESTART;
 	}
 
-	if (instance->mpeg2ts_clock_90k != MPEG2TS_PCR90K_INVALID)
-		instance->mpeg2ts_clock_90k += MPEG2TS_CLOCK_INC;
-
 	/* timer update */
 	hrtimer_add_expires_ns(&instance->timer, instance->timer_interval);
 
@@ -2589,13 +3248,53 @@ static u32 mse_ptp_timer_callback(void *arg)
 	return 0;
 }
 
+/*
+ * dequeue timestamps of an AVTPDU into crf_tstamps and return how many
+ * to put in the packet. Captured timestamps are all used as measured.
+ * With ptp timer, only the first one is used and the packetizer makes
+ * the others from the timestamp interval.
+ */
+static int mse_crf_deq_tstamps(struct mse_instance *instance, int tsize)
+{
+	unsigned long flags;
+	u64 *timestamps = instance->crf_tstamps;
+	u64 offset = 0, tmp;
+	int size, count, i;
+
+	spin_lock_irqsave(&instance->lock_ques, flags);
+	size = tstamps_get_tstamps_size(&instance->tstamp_que_crf);
+
+	mse_debug("size %d tsize %d\n", size, tsize);
+
+	if (size < tsize) {
+		spin_unlock_irqrestore(&instance->lock_ques, flags);
+		return 0;
+	}
+
+	count = instance->f_ptp_capture ? tsize : 1;
+	for (i = 0; i < count; i++)
+		tstamps_deq_tstamp(&instance->tstamp_que_crf, &timestamps[i]);
+	for (; i < tsize; i++)
+		tstamps_deq_tstamp(&instance->tstamp_que_crf, &tmp);
+	spin_unlock_irqrestore(&instance->lock_ques, flags);
+
+	if (instance->tx)
+		offset += instance->max_transit_time_ns;
+
+	if (instance->f_ptp_capture)
+		offset += instance->delay_time_ns;
+
+	for (i = 0; i < count; i++)
+		timestamps[i] += offset;
+
+	return count;
+}
+
 static void mse_work_crf_send(struct work_struct *work)
 {
 	struct mse_instance *instance;
-	int err, tsize, size, i;
-	u64 timestamp;
-	u64 timestamps[6];
-	unsigned long flags;
+	struct mse_packet_ctrl *dma;
+	int err, tsize, count, made;
 
 	mse_debug("START\n");
 
@@ -2607,48 +3306,42 @@ static void mse_work_crf_send(struct work_struct *work)
 		return;
 	}
 
-	tsize = (!instance->f_ptp_capture) ?
-		CRF_PTP_TIMESTAMPS : CRF_AUDIO_TIMESTAMPS;
-	timestamp = 0;
+	dma = instance->crf_packet_buffer;
+	tsize = instance->crf_tstamps_per_pdu;
 
 	do {
-		spin_lock_irqsave(&instance->lock_ques, flags);
-		size = tstamps_get_tstamps_size(&instance->tstamp_que_crf);
+		/* create all CRF packets of this tick */
+		made = 0;
+		while (mse_packet_ctrl_check_packet_remain(dma) <
+		       dma->size - 1) {
+			count = mse_crf_deq_tstamps(instance, tsize);
+			if (!count)
+				break;
 
-		/* get Timestamps */
-		mse_debug("size %d tsize %d\n", size, tsize);
-
-		if (size < tsize) {
-			spin_unlock_irqrestore(&instance->lock_ques, flags);
-			break;
-		}
-
-		for (i = 0; i < tsize; i++) {
-			tstamps_deq_tstamp(&instance->tstamp_que_crf,
-					   &timestamp);
-
-			if (instance->tx)
-				timestamp += instance->max_transit_time_ns;
-
-			if (instance->f_ptp_capture)
-				timestamp += instance->delay_time_ns;
+			err = mse_packet_ctrl_make_packet_crf(
+				instance->crf_index,
+				instance->crf_tstamps,
+				count,
+				dma);
+			if (err < 0)
+				break;
 
-			timestamps[i] = timestamp;
+			made++;
 		}
-		spin_unlock_irqrestore(&instance->lock_ques, flags);
 
-		/* create CRF packets */
-		err = mse_packet_ctrl_make_packet_crf(
-			instance->crf_index,
-			timestamps,
-			tsize,
-			instance->crf_packet_buffer);
+		if (!made)
+			break;
 
-		/* send packets */
+		/* send packets at once */
 		err = mse_packet_ctrl_send_packet(
 			instance->crf_index_network,
-			instance->crf_packet_buffer,
+			MSE_TX_PACKET_NUM,
+			dma,
 			instance->network);
+		if (err < 0) {
+			mse_err("send error %d\n", err);
+			break;
+		}
 
 		/* state is RUNNABLE */
 	} while (mse_state_test(instance, MSE_STATE_RUNNABLE));
@@ -2662,13 +3355,14 @@ static void mse_work_crf_receive(struct work_struct *work)
 	struct mse_adapter *adapter;
 	struct mse_audio_info audio_info;
 	int err, count, i;
-	u64 ptimes[6];
+	u64 *ptimes;
 	unsigned long flags;
 
 	struct mse_packetizer_ops *crf = &mse_packetizer_crf_tstamp_audio_ops;
 
 	instance = container_of(work, struct mse_instance, wk_crf_receive);
 	adapter = instance->media;
+	ptimes = instance->crf_tstamps;
 
 	mse_debug("START\n");
 
@@ -2686,7 +3380,7 @@ static void mse_work_crf_receive(struct work_struct *work)
 		count = mse_packet_ctrl_take_out_packet_crf(
 			instance->crf_index,
 			ptimes,
-			ARRAY_SIZE(ptimes),
+			ARRAY_SIZE(instance->crf_tstamps),
 			instance->crf_packet_buffer);
 
 		mse_debug("crf receive %d timestamp\n", count);
@@ -2771,59 +3465,82 @@ static int mse_get_capture_timestamp(struct mse_instance *instance,
 				     u64 now,
 				     bool is_first)
 {
-	int ret;
-	int count, i;
-	s64 diff;
+	struct mse_ptp_capture_ring *ring;
+	u64 *tstamps = instance->capture_tstamps;
+	u32 head, pos, count, skip, i;
+	s64 diff = 0;
 	unsigned long flags;
 
-	/* get timestamps */
-	ret = mse_ptp_get_timestamps(instance->ptp_index,
-				     instance->ptp_handle,
-				     ARRAY_SIZE(instance->timestamps),
-				     instance->timestamps);
-	if (ret <= 0) {
-		mse_warn("could not get timestamps ret=%d\n", ret);
+	/* poll PTP driver once for all readers of the hub */
+	mse_capture_hub_update(instance->capture_hub);
+
+	ring = instance->capture_hub->ring;
+	head = smp_load_acquire(&ring->head);
+	pos = instance->ptp_capture_pos;
+
+	/* overflowed, skip to oldest valid entry */
+	if (head - pos > ring->size - 1) {
+		mse_warn("capture ring overrun %u\n", head - pos);
+		pos = head - (ring->size - 1);
+	}
+
+	/* keep newest entries, if more than local copy */
+	if (head - pos > ARRAY_SIZE(instance->capture_tstamps))
+		pos = head - ARRAY_SIZE(instance->capture_tstamps);
+
+	instance->ptp_capture_pos = head;
+
+	count = head - pos;
+	if (!count)
 		return 0;
+
+	for (i = 0; i < count; i++)
+		tstamps[i] = capture_ring_entry(ring, pos + i);
+
+	/* drop entries the producer may have overwritten while copying */
+	smp_rmb();
+	skip = READ_ONCE(ring->head) - pos;
+	if (skip > ring->size - 1) {
+		skip = min(skip - (ring->size - 1), count);
+		mse_warn("capture ring overrun while reading %u\n", skip);
+		if (skip == count)
+			return 0;
+	} else {
+		skip = 0;
 	}
 
-	count = ret;
-	mse_debug("mse_ptp_get_timestamps %d %llu - %llu\n",
-		  count,
-		  instance->timestamps[0],
-		  instance->timestamps[count - 1]);
+	mse_debug("capture timestamps %u %llu - %llu\n",
+		  count - skip, tstamps[skip], tstamps[count - 1]);
 
+	i = skip;
 	if (is_first) {
 		/* skip older timestamp */
-		for (i = 0; i < count; i++) {
-			diff = (s64)(now - instance->timestamps[i]) -
+		for (; i < count; i++) {
+			diff = (s64)(now - tstamps[i]) -
 				(s64)instance->delay_time_ns;
 			if (diff <= 0)
 				break;
 		}
 
-		if (i) {
+		if (i != skip) {
 			i--;
 		} else {
 			/* not enough timestamps */
 			instance->delay_time_ns += diff;
 		}
-	} else {
-		i = 0;
 	}
 
 	/* store timestamps */
 	spin_lock_irqsave(&instance->lock_ques, flags);
 
 	for (; i < count; i++) {
-		tstamps_enq_tstamp(&instance->tstamp_que,
-				   instance->timestamps[i]);
-		tstamps_enq_tstamp(&instance->tstamp_que_crf,
-				   instance->timestamps[i]);
+		tstamps_enq_tstamp(&instance->tstamp_que, tstamps[i]);
+		tstamps_enq_tstamp(&instance->tstamp_que_crf, tstamps[i]);
 	}
 
 	spin_unlock_irqrestore(&instance->lock_ques, flags);
 
-	return count;
+	return count - skip;
 }
 
 static void mse_start_streaming_audio(struct mse_instance *instance, u64 now)
@@ -2902,6 +3619,7 @@ static void mse_start_streaming_audio(struct mse_instance *instance, u64 now)
 static void mse_tstamp_init(struct mse_instance *instance, u64 now)
 {
 	instance->timestamp = now;
+	instance->f_frame_continue = false;
 
 	instance->f_present = false;
 	instance->f_get_first_packet = false;
@@ -2910,8 +3628,6 @@ static void mse_tstamp_init(struct mse_instance *instance, u64 now)
 
 static void mse_start_streaming_common(struct mse_instance *instance)
 {
-	int i;
-
 	reinit_completion(&instance->completion_stop);
 	instance->f_streaming = false;
 	instance->f_continue = false;
@@ -2922,15 +3638,15 @@ static void mse_start_streaming_common(struct mse_instance *instance)
 	instance->mpeg2ts_pre_pcr_pid = MPEG2TS_PCR_PID_IGNORE;
 	instance->mpeg2ts_pcr_90k = MPEG2TS_PCR90K_INVALID;
 	instance->mpeg2ts_pre_pcr_90k = MPEG2TS_PCR90K_INVALID;
+	memset(&instance->mpeg2ts_scan, 0, sizeof(instance->mpeg2ts_scan));
+	instance->mpeg2ts_scan.pcr_90k = MPEG2TS_PCR90K_INVALID;
 	instance->f_depacketizing = false;
 	instance->processed = 0;
-
-	if (instance->tx && IS_MSE_TYPE_MPEG2TS(instance->media->type)) {
-		for (i = 0; i < MSE_MPEG2TS_BUF_NUM; i++) {
-			instance->mpeg2ts_buffer[i].buffer_size = 0;
-			instance->mpeg2ts_buffer[i].work_length = 0;
-		}
-	}
+	instance->mpeg2ts_held_cnt = 0;
+	instance->mpeg2ts_held_size = 0;
+	instance->pacing_gap = 0;
+	instance->f_frame_start = true;
+	instance->cbs_adapt.window_start = 0;
 
 	/* start timer */
 	if (instance->ptp_timer_handle) {
@@ -2943,146 +3659,326 @@ static void mse_start_streaming_common(struct mse_instance *instance)
 	}
 }
 
-static void mpeg2ts_buffer_free(struct mse_instance *instance)
+static int mpeg2ts_packet_size(struct mse_instance *instance)
 {
-	int i;
-	struct mse_trans_buffer *mpeg2ts;
+	if (instance->media_config.mpeg2ts.mpeg2ts_type == MSE_MPEG2TS_TYPE_TS)
+		return MPEG2TS_TS_SIZE;
+	else
+		return MPEG2TS_M2TS_SIZE;
+}
 
-	/* NOT allocated, skip */
-	if (!instance->mpeg2ts_buffer_base)
+static void mpeg2ts_clock_set(struct mse_instance *instance, u64 clock_90k)
+{
+	u64 now;
+
+	mse_ptp_get_time(instance->ptp_index, &now);
+
+	instance->mpeg2ts_clock_90k = clock_90k;
+	instance->mpeg2ts_clock_base_90k = clock_90k;
+	instance->mpeg2ts_clock_base_ns = now;
+	instance->mpeg2ts_clock_ppb = 0;
+	instance->mpeg2ts_clock_lead_ref = 0;
+}
+
+static u64 mpeg2ts_clock_update(struct mse_instance *instance, u64 now)
+{
+	s64 elapsed, ticks;
+
+	if (instance->mpeg2ts_clock_90k == MPEG2TS_PCR90K_INVALID)
+		return MPEG2TS_PCR90K_INVALID;
+
+	elapsed = now - instance->mpeg2ts_clock_base_ns;
+	elapsed += div_s64(elapsed * instance->mpeg2ts_clock_ppb,
+			   NSEC_PER_SEC);
+	ticks = ns_to_90k(elapsed);
+
+	instance->mpeg2ts_clock_90k = (instance->mpeg2ts_clock_base_90k +
+				       ticks) &
+				      (BIT(MPEG2TS_PCR90K_BITS) - 1);
+
+	return instance->mpeg2ts_clock_90k;
+}
+
+static void mpeg2ts_clock_pll(struct mse_instance *instance, u64 pcr)
+{
+	u64 now;
+	s64 lead, err_ns, ppb;
+
+	if (instance->mpeg2ts_clock_90k == MPEG2TS_PCR90K_INVALID)
 		return;
 
-	for (i = 0; i < MSE_MPEG2TS_BUF_NUM; i++) {
-		mpeg2ts = &instance->mpeg2ts_buffer[i];
-		mpeg2ts->buffer = NULL;
+	mse_ptp_get_time(instance->ptp_index, &now);
+	mpeg2ts_clock_update(instance, now);
+
+	/* PCR arriving ahead of the clock, keep it constant */
+	lead = (s64)((pcr - instance->mpeg2ts_clock_90k) <<
+		     (64 - MPEG2TS_PCR90K_BITS)) >> (64 - MPEG2TS_PCR90K_BITS);
+	if (!instance->mpeg2ts_clock_lead_ref) {
+		instance->mpeg2ts_clock_lead_ref = lead ? lead : 1;
+		return;
 	}
 
-	kfree(instance->mpeg2ts_buffer_base);
-	instance->mpeg2ts_buffer_base = NULL;
+	/* source faster than clock, lead grows and clock is sped up */
+	err_ns = clk90k_to_ns(lead - instance->mpeg2ts_clock_lead_ref);
+
+	/* PCR jumped, not a drift, restart clock from this PCR */
+	if (abs(err_ns) > MPEG2TS_PLL_DISCONT_NS) {
+		mse_info("pcr discontinuity %lld ns\n", err_ns);
+		mpeg2ts_clock_set(instance, pcr);
+		return;
+	}
+
+	/* err_ns is bounded above, no overflow */
+	ppb = div_s64(err_ns * NSEC_PER_SEC, MPEG2TS_PLL_TAU_NS);
+	ppb = clamp_t(s64, ppb, -MPEG2TS_PLL_PPB_MAX, MPEG2TS_PLL_PPB_MAX);
+
+	/* re-anchor to keep clock continuous */
+	instance->mpeg2ts_clock_base_90k = instance->mpeg2ts_clock_90k;
+	instance->mpeg2ts_clock_base_ns = now;
+	instance->mpeg2ts_clock_ppb = ppb;
+
+	mse_debug("pll lead=%lld ref=%lld ppb=%lld\n",
+		  lead, instance->mpeg2ts_clock_lead_ref, ppb);
+}
+
+static void mpeg2ts_update_rate(struct mpeg2ts_scanner *scan,
+				u64 pcr, u64 pos)
+{
+	u64 dpcr, measured;
+
+	dpcr = (pcr - scan->pcr_90k) & (BIT(MPEG2TS_PCR90K_BITS) - 1);
+
+	/* first PCR, or discontinuity more than 1 sec */
+	if (scan->pcr_90k == MPEG2TS_PCR90K_INVALID || !dpcr ||
+	    dpcr > 90000 || pos <= scan->pcr_pos)
+		goto out;
+
+	measured = div64_u64((pos - scan->pcr_pos) * 90000, dpcr);
+	if (!scan->rate)
+		scan->rate = measured;
+	else
+		scan->rate = scan->rate -
+			div64_u64(scan->rate, MPEG2TS_RATE_WEIGHT) +
+			div64_u64(measured, MPEG2TS_RATE_WEIGHT);
+
+out:
+	scan->pcr_90k = pcr;
+	scan->pcr_pos = pos;
 }
 
-static int mpeg2ts_buffer_alloc(struct mse_instance *instance)
+static u64 mpeg2ts_pos_to_time(struct mse_instance *instance, u64 pos)
 {
+	struct mpeg2ts_scanner *scan = &instance->mpeg2ts_scan;
+	s64 ticks;
+
+	if (!scan->rate || scan->pcr_90k == MPEG2TS_PCR90K_INVALID ||
+	    instance->mpeg2ts_clock_90k == MPEG2TS_PCR90K_INVALID)
+		return 0;
+
+	/* PCR interpolated from last PCR by estimated mux rate */
+	ticks = div64_s64(((s64)pos - (s64)scan->pcr_pos) * 90000,
+			  scan->rate);
+	ticks += (s64)((scan->pcr_90k - instance->mpeg2ts_clock_base_90k) <<
+		       (64 - MPEG2TS_PCR90K_BITS)) >>
+		 (64 - MPEG2TS_PCR90K_BITS);
+
+	return instance->mpeg2ts_clock_base_ns + clk90k_to_ns(ticks);
+}
+
+static int mpeg2ts_resync(u8 *data, size_t size, size_t pos, int psize,
+			  int offset)
+{
+	u8 *p;
+	size_t next;
 	int i;
-	unsigned char *buf;
-	struct mse_trans_buffer *mpeg2ts;
 
-	buf = kmalloc_array(MSE_MPEG2TS_BUF_SIZE,
-			    MSE_MPEG2TS_BUF_NUM, GFP_KERNEL);
+	while (pos + offset < size) {
+		/* find sync byte candidate */
+		p = memchr(data + pos + offset, MPEG2TS_SYNC,
+			   size - pos - offset);
+		if (!p)
+			return -1;
 
-	if (!buf)
-		return -ENOMEM;
+		pos = p - data - offset;
 
-	instance->mpeg2ts_buffer_base = buf;
-	instance->mpeg2ts_buffer_idx = 0;
-	for (i = 0; i < MSE_MPEG2TS_BUF_NUM; i++) {
-		mpeg2ts = &instance->mpeg2ts_buffer[i];
-		mpeg2ts->buffer = buf + MSE_MPEG2TS_BUF_SIZE * i;
-		mpeg2ts->media_buffer = NULL;
-		mpeg2ts->buffer_size = 0;
-		mpeg2ts->work_length = 0;
-		mpeg2ts->private_data = NULL;
-		mpeg2ts->mse_completion = NULL;
+		/* confirm sync bytes of following packets */
+		for (i = 1; i < MPEG2TS_SYNC_LOCK_COUNT; i++) {
+			next = pos + i * psize + offset;
+			if (next >= size || data[next] != MPEG2TS_SYNC)
+				break;
+		}
+
+		/* locked, or no more data to confirm */
+		if (i == MPEG2TS_SYNC_LOCK_COUNT ||
+		    pos + i * psize + offset >= size)
+			return pos;
+
+		pos++;
 	}
 
-	return 0;
+	return -1;
 }
 
-static int mpeg2ts_packet_size(struct mse_instance *instance)
+/* inspect one TS packet, true if it gives a new PCR to release buffers */
+static bool mpeg2ts_inspect_packet(struct mse_instance *instance, u8 *tsp,
+				   u64 pcr_pos)
 {
-	if (instance->media_config.mpeg2ts.mpeg2ts_type == MSE_MPEG2TS_TYPE_TS)
-		return MPEG2TS_TS_SIZE;
-	else
-		return MPEG2TS_M2TS_SIZE;
+	struct mpeg2ts_scanner *scan = &instance->mpeg2ts_scan;
+	u8 afc, afc_len, pcr_flag;
+	u16 pid;
+	u16 pcr_pid = instance->media_config.mpeg2ts.pcr_pid;
+	u64 pcr;
+	bool ret = false;
+
+	if (scan->pcr_lost < MPEG2TS_PCR_LOST_PACKETS)
+		scan->pcr_lost++;
+
+	pid = (((u16)tsp[1] << 8) + (u16)tsp[2]) & 0x1fff;
+
+	/* only PCR PID is inspected */
+	if (pcr_pid != MPEG2TS_PCR_PID_IGNORE && pcr_pid != pid)
+		return false;
+
+	/* PCR of other program, while locked PCR PID is alive */
+	if (pcr_pid == MPEG2TS_PCR_PID_IGNORE &&
+	    instance->mpeg2ts_pre_pcr_pid != pid &&
+	    test_bit(pid, scan->pcr_pid_map) &&
+	    scan->pcr_lost < MPEG2TS_PCR_LOST_PACKETS)
+		return false;
+
+	afc = (tsp[3] & 0x30) >> 4;
+	afc_len = tsp[4];
+	pcr_flag = (tsp[5] & 0x10) >> 4;
+
+	/* Adaptation Field Control = 0b10 or 0b11 and  */
+	/* afc_len >= 7 and pcr_flag = 1 */
+	if (!(afc & 0x2) || (afc_len < 7) || !pcr_flag)
+		return false;    /* no PCR */
+
+	mse_debug("find pcr %d (required %d)\n", pid, pcr_pid);
+	/* PCR base: 90KHz, 33bits (32+1bits) */
+	pcr = ((u64)tsp[6] << 25) |
+		((u64)tsp[7] << 17) |
+		((u64)tsp[8] << 9) |
+		((u64)tsp[9] << 1) |
+		(((u64)tsp[10] & 0x80) >> 7);
+
+	if (pcr_pid == MPEG2TS_PCR_PID_IGNORE) {
+		set_bit(pid, scan->pcr_pid_map);
+
+		if (instance->mpeg2ts_pre_pcr_pid != MPEG2TS_PCR_PID_IGNORE &&
+		    (instance->mpeg2ts_pre_pcr_pid != pid ||
+		     compare_pcr(instance->mpeg2ts_pre_pcr_90k, pcr))) {
+			mse_info("change pid(%d -> %d) or rewind\n",
+				 instance->mpeg2ts_pre_pcr_pid,
+				pid);
+			mpeg2ts_clock_set(instance, pcr);
+			instance->mpeg2ts_pcr_90k = pcr;
+			scan->pcr_90k = MPEG2TS_PCR90K_INVALID;
+			instance->mpeg2ts_pre_pcr_pid = pid;
+			instance->mpeg2ts_pre_pcr_90k = pcr;
+
+			ret = true;
+		}
+	}
+	scan->pcr_lost = 0;
+	instance->mpeg2ts_pre_pcr_pid = pid;
+	instance->mpeg2ts_pre_pcr_90k = pcr;
+	mpeg2ts_update_rate(scan, pcr, pcr_pos);
+	mpeg2ts_clock_pll(instance, pcr);
+	/*
+	 * PCR extension: 27MHz, 9bits (8+1bits)
+	 * Note: MSE is ignore PCR extension.
+	 *
+	 * pcr_ext = ((tsp[10] & 0x1) << 9) | tsp[11];
+	 */
+	if (compare_pcr(pcr, instance->mpeg2ts_clock_90k)) {
+		if (instance->mpeg2ts_clock_90k == MPEG2TS_PCR90K_INVALID)
+			mpeg2ts_clock_set(instance, pcr);
+		instance->mpeg2ts_pcr_90k = pcr;
+
+		ret = true;
+	}
+
+	return ret;
 }
 
 static bool check_mpeg2ts_pcr(struct mse_instance *instance,
 			      struct mse_trans_buffer *buf)
 {
+	struct mpeg2ts_scanner *scan = &instance->mpeg2ts_scan;
+	u8 *data = buf->media_buffer;
+	size_t size = buf->buffer_size;
+	size_t pos = 0;
+	size_t need;
 	u8 *tsp;
-	u8 afc, afc_len, pcr_flag;
-	u16 pid;
-	u16 pcr_pid = instance->media_config.mpeg2ts.pcr_pid;
-	u64 pcr;
-	int psize, offset;
-	int skip = 0;
+	int psize, offset, ret_sync;
 	bool ret = false;
 
 	psize = mpeg2ts_packet_size(instance);
 	offset = psize - MPEG2TS_TS_SIZE;
 
-	while (buf->work_length + psize < buf->buffer_size) {
-		tsp = buf->buffer + buf->work_length + offset;
-
-		/* check sync byte */
-		if (buf->work_length + psize < buf->buffer_size &&
-		    tsp[0] != MPEG2TS_SYNC) {
-			buf->work_length++;
-			skip++;
-			continue;
+	/* complete packet split at end of previous buffer */
+	if (scan->f_locked && scan->carry_len) {
+		need = min_t(size_t, psize - scan->carry_len, size);
+		memcpy(scan->carry + scan->carry_len, data, need);
+		scan->carry_len += need;
+		pos = need;
+
+		if (scan->carry_len == psize) {
+			tsp = scan->carry + offset;
+			if (tsp[0] != MPEG2TS_SYNC) {
+				mse_debug("lost sync at split packet\n");
+				scan->f_locked = false;
+				pos = 0;
+			} else if (mpeg2ts_inspect_packet(instance, tsp,
+							  scan->bytes -
+							  psize + need)) {
+				ret = true;
+			}
+			scan->carry_len = 0;
 		}
+	}
+
+	while (pos + psize <= size) {
+		if (!scan->f_locked) {
+			ret_sync = mpeg2ts_resync(data, size, pos, psize,
+						  offset);
+			if (ret_sync < 0) {
+				pos = size;
+				break;
+			}
 
-		if (skip) {
-			mse_debug("check sync byte. skip %d byte\n",
-				  skip);
-			skip = 0;
+			if ((size_t)ret_sync != pos)
+				mse_debug("check sync byte. skip %zu byte\n",
+					  (size_t)ret_sync - pos);
+
+			pos = ret_sync;
+			scan->f_locked = true;
+			continue;
 		}
 
-		buf->work_length += psize;
-
-		pid = (((u16)tsp[1] << 8) + (u16)tsp[2]) & 0x1fff;
-		afc = (tsp[3] & 0x30) >> 4;
-		afc_len = tsp[4];
-		pcr_flag = (tsp[5] & 0x10) >> 4;
-
-		/* Adaptation Field Control = 0b10 or 0b11 and  */
-		/* afc_len >= 7 and pcr_flag = 1 */
-		if (!(afc & 0x2) || (afc_len < 7) || !pcr_flag)
-			continue;    /* no PCR */
-
-		mse_debug("find pcr %d (required %d)\n", pid, pcr_pid);
-		/* PCR base: 90KHz, 33bits (32+1bits) */
-		pcr = ((u64)tsp[6] << 25) |
-			((u64)tsp[7] << 17) |
-			((u64)tsp[8] << 9) |
-			((u64)tsp[9] << 1) |
-			(((u64)tsp[10] & 0x80) >> 7);
-
-		if (pcr_pid == MPEG2TS_PCR_PID_IGNORE) {
-			if (instance->mpeg2ts_pre_pcr_pid !=
-			    MPEG2TS_PCR_PID_IGNORE &&
-			    (instance->mpeg2ts_pre_pcr_pid != pid ||
-			     compare_pcr(instance->mpeg2ts_pre_pcr_90k, pcr))) {
-				mse_info("change pid(%d -> %d) or rewind\n",
-					 instance->mpeg2ts_pre_pcr_pid,
-					pid);
-				instance->mpeg2ts_clock_90k = pcr;
-				instance->mpeg2ts_pcr_90k = pcr;
-				instance->mpeg2ts_pre_pcr_pid = pid;
-				instance->mpeg2ts_pre_pcr_90k = pcr;
+		tsp = data + pos + offset;
 
-				ret = true;
-			}
-		} else if (pcr_pid != pid) {
+		/* check sync byte */
+		if (tsp[0] != MPEG2TS_SYNC) {
+			mse_debug("lost sync at %zu\n", pos);
+			scan->f_locked = false;
 			continue;
 		}
-		instance->mpeg2ts_pre_pcr_pid = pid;
-		instance->mpeg2ts_pre_pcr_90k = pcr;
-		/*
-		 * PCR extension: 27MHz, 9bits (8+1bits)
-		 * Note: MSE is ignore PCR extension.
-		 *
-		 * pcr_ext = ((tsp[10] & 0x1) << 9) | tsp[11];
-		 */
-		if (compare_pcr(pcr, instance->mpeg2ts_clock_90k)) {
-			if (instance->mpeg2ts_clock_90k ==
-			    MPEG2TS_PCR90K_INVALID)
-				instance->mpeg2ts_clock_90k = pcr;
-			instance->mpeg2ts_pcr_90k = pcr;
 
+		if (mpeg2ts_inspect_packet(instance, tsp, scan->bytes + pos))
 			ret = true;
-		}
+
+		pos += psize;
+	}
+
+	/* keep head of split packet, completed by next buffer */
+	if (scan->f_locked && pos < size) {
+		scan->carry_len = size - pos;
+		memcpy(scan->carry, data + pos, scan->carry_len);
 	}
+	scan->bytes += size;
 
 	return ret;
 }
@@ -3102,8 +3998,12 @@ static void mpeg2ts_adjust_pcr(struct mse_instance *instance,
 	u64 bitrate = instance->media_config.mpeg2ts.bitrate;
 	u64 progress;
 
+	/* prefer mux rate estimated from PCR */
+	if (instance->mpeg2ts_scan.rate)
+		bitrate = instance->mpeg2ts_scan.rate * 8;
+
 	if (instance->mpeg2ts_clock_90k == MPEG2TS_PCR90K_INVALID)
-		instance->mpeg2ts_clock_90k = 0;
+		mpeg2ts_clock_set(instance, 0);
 
 	if (instance->mpeg2ts_pcr_90k == MPEG2TS_PCR90K_INVALID)
 		instance->mpeg2ts_pcr_90k = 0;
@@ -3124,108 +4024,91 @@ static void mpeg2ts_adjust_pcr(struct mse_instance *instance,
 		  instance->mpeg2ts_clock_90k, instance->mpeg2ts_pcr_90k);
 }
 
-static void mpeg2ts_buffer_flush(struct mse_instance *instance)
+static void mpeg2ts_buffer_release(struct mse_instance *instance)
 {
-	struct mse_trans_buffer *mpeg2ts;
-	int idx;
+	struct mse_trans_buffer *buf;
+
+	/* packetize held buffers directly from media buffer, in order */
+	list_for_each_entry(buf, &instance->proc_buf_list, list)
+		if (!buf->buffer)
+			buf->buffer = buf->media_buffer;
 
-	idx = instance->mpeg2ts_buffer_idx;
-	mpeg2ts = &instance->mpeg2ts_buffer[idx];
+	instance->mpeg2ts_held_cnt = 0;
+	instance->mpeg2ts_held_size = 0;
+}
 
-	if (!mpeg2ts->buffer_size)
+static void mpeg2ts_buffer_flush(struct mse_instance *instance)
+{
+	size_t held_size = instance->mpeg2ts_held_size;
+
+	if (!instance->mpeg2ts_held_cnt)
 		return; /* no data */
 
 #ifdef DEBUG
-	mse_debug("flush %zu bytes, before stopping.\n", mpeg2ts->buffer_size);
+	mse_debug("flush %zu bytes, before stopping.\n", held_size);
 #endif
 
-	/* add mpeg2ts buffer to proc buffer list*/
-	mpeg2ts->work_length = 0;
-	list_add_tail(&mpeg2ts->list, &instance->proc_buf_list);
-	atomic_inc(&instance->trans_buf_cnt);
-	instance->mpeg2ts_buffer_idx = (idx + 1) % MSE_MPEG2TS_BUF_NUM;
-
-	mpeg2ts_adjust_pcr(instance, mpeg2ts->buffer_size);
+	mpeg2ts_buffer_release(instance);
+	mpeg2ts_adjust_pcr(instance, held_size);
 }
 
-static int mpeg2ts_buffer_write(struct mse_instance *instance,
-				struct mse_trans_buffer *buf)
+static int mpeg2ts_buffer_hold(struct mse_instance *instance,
+			       struct mse_trans_buffer *buf)
 {
 	bool trans_start;
 	bool force_flush = false;
-	unsigned char *buffer = buf->media_buffer;
-	size_t buffer_size = buf->buffer_size;
-	struct mse_trans_buffer *mpeg2ts;
-	int idx;
-	size_t request_size;
-
-	idx = instance->mpeg2ts_buffer_idx;
-	mpeg2ts = &instance->mpeg2ts_buffer[idx];
-
-	mpeg2ts->media_buffer = buffer;
-	mpeg2ts->private_data = buf->private_data;
-	mpeg2ts->mse_completion = buf->mse_completion;
-
-	request_size = mpeg2ts->buffer_size + buffer_size;
-	if (request_size > MSE_MPEG2TS_BUF_SIZE) {
-		mse_err("mpeg2ts buffer overrun %zu/%u\n",
-			request_size, MSE_MPEG2TS_BUF_SIZE);
-		mse_trans_complete(instance, -EIO);
-
-		/* state is STOPPING */
-		if (mse_state_test(instance, MSE_STATE_STOPPING))
-			queue_work(instance->wq_packet,
-				   &instance->wk_stop_streaming);
-
-		return -1;
-	}
-
-	mse_debug("to=%p from=%p size=%zu, buffer_size=%zu\n",
-		  mpeg2ts->buffer + mpeg2ts->buffer_size,
-		  buffer, buffer_size,
-		  mpeg2ts->buffer_size + buffer_size);
+	size_t held_size;
+	u64 top = instance->mpeg2ts_scan.bytes;
+	u64 timestamp;
 
-	memcpy(mpeg2ts->buffer + mpeg2ts->buffer_size,
-	       buffer, buffer_size);
-	mpeg2ts->buffer_size += buffer_size;
+	/* hold media buffer, until PCR of data is reached */
+	buf->buffer = NULL;
+	instance->mpeg2ts_held_cnt++;
+	instance->mpeg2ts_held_size += buf->buffer_size;
+	held_size = instance->mpeg2ts_held_size;
 
-	if (request_size + buffer_size >= MSE_MPEG2TS_BUF_THRESH)
+	/* enough data without reaching PCR, independent of queue depth */
+	if (held_size >= MSE_MPEG2TS_BUF_THRESH)
 		force_flush = true;
 
 #ifdef DEBUG
 	if (force_flush)
-		mse_debug("flush %zu bytes.\n", mpeg2ts->buffer_size);
+		mse_debug("flush %zu bytes.\n", held_size);
 #endif
 
-	trans_start = check_mpeg2ts_pcr(instance, mpeg2ts);
+	trans_start = check_mpeg2ts_pcr(instance, buf);
+	timestamp = mpeg2ts_pos_to_time(instance, top);
+	if (timestamp)
+		buf->timestamp = timestamp;
 
-	if (!trans_start && !force_flush) {
-		/* Not enough data, request next buffer */
-		mse_trans_complete(instance, buffer_size);
+	if (trans_start || force_flush) {
+		instance->f_trans_start = true;
 
-		return -1;
-	}
+		mpeg2ts_buffer_release(instance);
 
-	instance->f_trans_start = true;
+		/* PCR found in data takes precedence over estimation */
+		if (!trans_start &&
+		    instance->mpeg2ts_clock_90k != MPEG2TS_PCR90K_INVALID)
+			mpeg2ts_adjust_pcr(instance, held_size);
 
-	/* replace proc buffer */
-	list_del(&buf->list);
-	buf->media_buffer = NULL;
-	buf->buffer_size = 0;
-	buf->private_data = NULL;
-	buf->mse_completion = NULL;
+		return 0;
+	}
 
-	mpeg2ts->work_length = 0;
-	list_add_tail(&mpeg2ts->list, &instance->proc_buf_list);
-	instance->mpeg2ts_buffer_idx = (idx + 1) % MSE_MPEG2TS_BUF_NUM;
+	/*
+	 * media adapter cannot queue more buffers, release them so that
+	 * it goes on. Pacing is left to PCR of following buffers.
+	 */
+	if (instance->mpeg2ts_held_cnt >= instance->trans_buf_depth) {
+		mse_debug("release %d buffers at queue depth\n",
+			  instance->mpeg2ts_held_cnt);
+		instance->f_trans_start = true;
+		mpeg2ts_buffer_release(instance);
 
-	if (!force_flush)
 		return 0;
+	}
 
-	if (instance->mpeg2ts_clock_90k != MPEG2TS_PCR90K_INVALID)
-		mpeg2ts_adjust_pcr(instance, mpeg2ts->buffer_size);
-
-	return 0;
+	/* Not enough data, wait for next buffer */
+	return -1;
 }
 
 static u64 ptp_timer_update_start_timing(struct mse_instance *instance, u64 now)
@@ -3279,6 +4162,7 @@ static void mse_work_start_transmission(struct work_struct *work)
 	struct mse_timing_ctrl *timing_ctrl;
 	int ret;
 	u64 now, ptp_timer_start;
+	bool frame_start;
 	unsigned long flags;
 
 	instance = container_of(work, struct mse_instance, wk_start_trans);
@@ -3296,8 +4180,8 @@ static void mse_work_start_transmission(struct work_struct *work)
 		spin_unlock_irqrestore(&instance->lock_buf_list, flags);
 		/* state is STOPPING */
 		if (mse_state_test(instance, MSE_STATE_STOPPING)) {
-			/* if using mpeg2ts buffer, flush last data */
-			if (instance->mpeg2ts_buffer_base) {
+			/* if holding mpeg2ts buffer, flush last data */
+			if (instance->mpeg2ts_held_cnt) {
 				mpeg2ts_buffer_flush(instance);
 				queue_work(instance->wq_packet,
 					   &instance->wk_packetize);
@@ -3334,16 +4218,23 @@ static void mse_work_start_transmission(struct work_struct *work)
 		  instance->index_media, buf->media_buffer,
 		  buf->buffer_size);
 
+	/* parts of a frame share the timestamp of its first part */
+	frame_start = !instance->f_frame_continue;
+	instance->f_frame_continue = instance->tx && buf->partial;
+
 	/* update timestamp(nsec) */
 	mse_ptp_get_time(instance->ptp_index, &now);
-	instance->timestamp = now;
+	if (frame_start)
+		instance->timestamp = now;
 
 	if (!instance->f_ptp_capture) {
-		spin_lock_irqsave(&instance->lock_ques, flags);
-		/* store ptp timestamp to AVTP and CRF */
-		tstamps_enq_tstamp(&instance->tstamp_que, now);
-		tstamps_enq_tstamp(&instance->tstamp_que_crf, now);
-		spin_unlock_irqrestore(&instance->lock_ques, flags);
+		if (frame_start) {
+			spin_lock_irqsave(&instance->lock_ques, flags);
+			/* store ptp timestamp to AVTP and CRF */
+			tstamps_enq_tstamp(&instance->tstamp_que, now);
+			tstamps_enq_tstamp(&instance->tstamp_que_crf, now);
+			spin_unlock_irqrestore(&instance->lock_ques, flags);
+		}
 	} else if (instance->ptp_timer_handle) {
 		ptp_timer_start = ptp_timer_update_start_timing(instance, now);
 		mse_debug("mse_ptp_timer_start %u now %u\n",
@@ -3361,8 +4252,10 @@ static void mse_work_start_transmission(struct work_struct *work)
 
 	adapter = instance->media;
 	if (instance->tx) {
+		buf->timestamp = instance->timestamp;
+
 		if (IS_MSE_TYPE_MPEG2TS(adapter->type))
-			if (mpeg2ts_buffer_write(instance, buf))
+			if (mpeg2ts_buffer_hold(instance, buf))
 				return;
 
 		if (IS_MSE_TYPE_AUDIO(adapter->type)) {
@@ -3499,6 +4392,7 @@ EXPORT_SYMBOL(mse_register_adapter_media);
 
 int mse_unregister_adapter_media(int index_media)
 {
+	struct mse_instance *instance;
 	int i;
 	unsigned long flags;
 
@@ -3514,12 +4408,15 @@ int mse_unregister_adapter_media(int index_media)
 		return -EINVAL;
 	}
 
-	for (i = 0; i < ARRAY_SIZE(mse->instance_table); i++) {
-		if (mse->instance_table[i].index_media == index_media) {
+	mutex_lock(&mse->mutex_open);
+	idr_for_each_entry(&mse->instance_idr, instance, i) {
+		if (instance->index_media == index_media) {
+			mutex_unlock(&mse->mutex_open);
 			mse_err("module is in use. instance=%d\n", i);
 			return -EPERM;
 		}
 	}
+	mutex_unlock(&mse->mutex_open);
 
 	/* delete control device */
 	mse_delete_config_device(index_media);
@@ -3584,6 +4481,7 @@ EXPORT_SYMBOL(mse_register_adapter_network);
 
 int mse_unregister_adapter_network(int index)
 {
+	struct mse_instance *instance;
 	int i;
 	unsigned long flags;
 
@@ -3599,12 +4497,15 @@ int mse_unregister_adapter_network(int index)
 		return -EINVAL;
 	}
 
-	for (i = 0; i < ARRAY_SIZE(mse->instance_table); i++) {
-		if (mse->instance_table[i].index_network == index) {
+	mutex_lock(&mse->mutex_open);
+	idr_for_each_entry(&mse->instance_idr, instance, i) {
+		if (instance->index_network == index) {
+			mutex_unlock(&mse->mutex_open);
 			mse_err("module is in use. instance=%d\n", i);
 			return -EPERM;
 		}
 	}
+	mutex_unlock(&mse->mutex_open);
 
 	spin_lock_irqsave(&mse->lock_tables, flags);
 	mse->network_table[index] = NULL;
@@ -3616,23 +4517,44 @@ int mse_unregister_adapter_network(int index)
 }
 EXPORT_SYMBOL(mse_unregister_adapter_network);
 
-int mse_get_audio_config(int index, struct mse_audio_config *config)
+static void audio_buffer_free(struct mse_instance *instance)
 {
-	struct mse_instance *instance;
+	int i;
 
-	if ((index < 0) || (index >= MSE_INSTANCE_MAX)) {
-		mse_err("invalid argument. index=%d\n", index);
-		return -EINVAL;
-	}
-	if (!config) {
-		mse_err("invalid argument. config\n");
-		return -EINVAL;
-	}
+	vfree(instance->temp_buffer[0]);
+	for (i = 0; i < MSE_DECODE_BUFFER_NUM; i++)
+		instance->temp_buffer[i] = NULL;
 
-	mse_debug("index=%d data=%p\n", index, config);
+	instance->temp_buffer_size = 0;
+}
 
-	instance = &mse->instance_table[index];
+/* allocate audio buffer for capture, one period each */
+static int audio_buffer_alloc(struct mse_instance *instance, size_t size)
+{
+	unsigned char *area;
+	int i;
+
+	if (size <= instance->temp_buffer_size)
+		return 0;
+
+	audio_buffer_free(instance);
+
+	area = vzalloc(size * MSE_DECODE_BUFFER_NUM);
+	if (!area)
+		return -ENOMEM;
+
+	for (i = 0; i < MSE_DECODE_BUFFER_NUM; i++)
+		instance->temp_buffer[i] = area + size * i;
+
+	instance->temp_buffer_size = size;
+
+	return 0;
+}
 
+static int __mse_get_audio_config(struct mse_instance *instance,
+				  int index,
+				  struct mse_audio_config *config)
+{
 	mse_debug_state(instance);
 
 	/* state is CLOSE */
@@ -3646,39 +4568,47 @@ int mse_get_audio_config(int index, struct mse_audio_config *config)
 
 	return 0;
 }
-EXPORT_SYMBOL(mse_get_audio_config);
 
-int mse_set_audio_config(int index, struct mse_audio_config *config)
+int mse_get_audio_config(int index, struct mse_audio_config *config)
 {
 	struct mse_instance *instance;
-	struct mse_adapter *adapter;
-	struct mse_media_audio_config *media_audio_config;
-	struct mse_network_config *net_config;
-	struct mse_packetizer_ops *packetizer;
-	struct mse_adapter_network_ops *network;
-	int index_packetizer, index_network;
 	int ret;
 
 	if ((index < 0) || (index >= MSE_INSTANCE_MAX)) {
 		mse_err("invalid argument. index=%d\n", index);
 		return -EINVAL;
 	}
-
 	if (!config) {
 		mse_err("invalid argument. config\n");
 		return -EINVAL;
 	}
 
 	mse_debug("index=%d data=%p\n", index, config);
-	mse_info("  sample_rate=%d channels=%d\n"
-		 "  period_size=%d bytes_per_sample=%d bit_depth=%d\n"
-		 "  is_big_endian=%d\n",
-		 config->sample_rate,  config->channels,
-		 config->period_size, config->bytes_per_sample,
-		 mse_get_bit_depth(config->sample_bit_depth),
-		 config->is_big_endian);
 
-	instance = &mse->instance_table[index];
+	instance = mse_instance_get(index);
+	if (!instance) {
+		mse_err("instance is not opened. index=%d\n", index);
+		return -EPERM;
+	}
+
+	ret = __mse_get_audio_config(instance, index, config);
+	mse_instance_put(instance);
+
+	return ret;
+}
+EXPORT_SYMBOL(mse_get_audio_config);
+
+static int __mse_set_audio_config(struct mse_instance *instance,
+				  int index,
+				  struct mse_audio_config *config)
+{
+	struct mse_adapter *adapter;
+	struct mse_media_audio_config *media_audio_config;
+	struct mse_network_config *net_config;
+	struct mse_packetizer_ops *packetizer;
+	struct mse_adapter_network_ops *network;
+	int index_packetizer, index_network;
+	int ret;
 
 	mse_debug_state(instance);
 
@@ -3708,6 +4638,18 @@ int mse_set_audio_config(int index, struct mse_audio_config *config)
 	network = instance->network;
 	index_network = instance->index_network;
 
+	/* capture buffers to hold one period each */
+	if (!instance->tx) {
+		ret = audio_buffer_alloc(instance,
+					 (size_t)config->period_size *
+					 config->channels *
+					 config->bytes_per_sample);
+		if (ret < 0) {
+			mse_err("cannot allocate audio buffer\n");
+			return ret;
+		}
+	}
+
 	/* calc timer value */
 	instance->timer_interval = div64_u64(
 		NSEC_SCALE * (u64)config->period_size,
@@ -3732,7 +4674,7 @@ int mse_set_audio_config(int index, struct mse_audio_config *config)
 		if (ret < 0)
 			return ret;
 
-		ret = network->set_cbs_param(index_network, &cbs);
+		ret = mse_network_set_cbs_param(instance, &cbs);
 		if (ret < 0)
 			return ret;
 	} else {
@@ -3754,11 +4696,11 @@ int mse_set_audio_config(int index, struct mse_audio_config *config)
 
 	return 0;
 }
-EXPORT_SYMBOL(mse_set_audio_config);
 
-int mse_get_video_config(int index, struct mse_video_config *config)
+int mse_set_audio_config(int index, struct mse_audio_config *config)
 {
 	struct mse_instance *instance;
+	int ret;
 
 	if ((index < 0) || (index >= MSE_INSTANCE_MAX)) {
 		mse_err("invalid argument. index=%d\n", index);
@@ -3771,9 +4713,31 @@ int mse_get_video_config(int index, struct mse_video_config *config)
 	}
 
 	mse_debug("index=%d data=%p\n", index, config);
+	mse_info("  sample_rate=%d channels=%d\n"
+		 "  period_size=%d bytes_per_sample=%d bit_depth=%d\n"
+		 "  is_big_endian=%d\n",
+		 config->sample_rate,  config->channels,
+		 config->period_size, config->bytes_per_sample,
+		 mse_get_bit_depth(config->sample_bit_depth),
+		 config->is_big_endian);
 
-	instance = &mse->instance_table[index];
+	instance = mse_instance_get(index);
+	if (!instance) {
+		mse_err("instance is not opened. index=%d\n", index);
+		return -EPERM;
+	}
+
+	ret = __mse_set_audio_config(instance, index, config);
+	mse_instance_put(instance);
+
+	return ret;
+}
+EXPORT_SYMBOL(mse_set_audio_config);
 
+static int __mse_get_video_config(struct mse_instance *instance,
+				  int index,
+				  struct mse_video_config *config)
+{
 	mse_debug_state(instance);
 
 	/* state is CLOSE */
@@ -3787,15 +4751,10 @@ int mse_get_video_config(int index, struct mse_video_config *config)
 
 	return 0;
 }
-EXPORT_SYMBOL(mse_get_video_config);
 
-int mse_set_video_config(int index, struct mse_video_config *config)
+int mse_get_video_config(int index, struct mse_video_config *config)
 {
 	struct mse_instance *instance;
-	struct mse_network_config *net_config;
-	struct mse_packetizer_ops *packetizer;
-	struct mse_adapter_network_ops *network;
-	int index_packetizer, index_network;
 	int ret;
 
 	if ((index < 0) || (index >= MSE_INSTANCE_MAX)) {
@@ -3809,12 +4768,29 @@ int mse_set_video_config(int index, struct mse_video_config *config)
 	}
 
 	mse_debug("index=%d data=%p\n", index, config);
-	mse_info("  format=%d bitrate=%d fps=%d/%d\n"
-		 "  bytes_per_frame=%d\n",
-		 config->format, config->bitrate, config->fps.numerator,
-		 config->fps.denominator, config->bytes_per_frame);
 
-	instance = &mse->instance_table[index];
+	instance = mse_instance_get(index);
+	if (!instance) {
+		mse_err("instance is not opened. index=%d\n", index);
+		return -EPERM;
+	}
+
+	ret = __mse_get_video_config(instance, index, config);
+	mse_instance_put(instance);
+
+	return ret;
+}
+EXPORT_SYMBOL(mse_get_video_config);
+
+static int __mse_set_video_config(struct mse_instance *instance,
+				  int index,
+				  struct mse_video_config *config)
+{
+	struct mse_network_config *net_config;
+	struct mse_packetizer_ops *packetizer;
+	struct mse_adapter_network_ops *network;
+	int index_packetizer, index_network;
+	int ret;
 
 	mse_debug_state(instance);
 
@@ -3872,6 +4848,11 @@ int mse_set_video_config(int index, struct mse_video_config *config)
 			NSEC_SCALE * (u64)config->fps.denominator,
 			config->fps.numerator);
 		mse_info("timer_interval=%llu\n", instance->timer_interval);
+
+		instance->pacing_ns = div_u64(
+			instance->timer_interval *
+			clamp(video_pacing, 0, MSE_PACING_PERCENT_MAX),
+			MSE_PACING_PERCENT_MAX);
 	}
 
 	/* set AVTP header info */
@@ -3891,10 +4872,12 @@ int mse_set_video_config(int index, struct mse_video_config *config)
 		if (ret < 0)
 			return ret;
 
-		ret = network->set_cbs_param(index_network, &cbs);
+		ret = mse_network_set_cbs_param(instance, &cbs);
 		if (ret < 0)
 			return ret;
 
+		mse_cbs_adapt_init(instance, &cbs);
+
 		mse_debug("bandwidth fraction = %08x\n",
 			  cbs.bandwidth_fraction);
 	} else {
@@ -3909,11 +4892,11 @@ int mse_set_video_config(int index, struct mse_video_config *config)
 
 	return 0;
 }
-EXPORT_SYMBOL(mse_set_video_config);
 
-int mse_get_mpeg2ts_config(int index, struct mse_mpeg2ts_config *config)
+int mse_set_video_config(int index, struct mse_video_config *config)
 {
 	struct mse_instance *instance;
+	int ret;
 
 	if ((index < 0) || (index >= MSE_INSTANCE_MAX)) {
 		mse_err("invalid argument. index=%d\n", index);
@@ -3926,9 +4909,28 @@ int mse_get_mpeg2ts_config(int index, struct mse_mpeg2ts_config *config)
 	}
 
 	mse_debug("index=%d data=%p\n", index, config);
+	mse_info("  format=%d bitrate=%d fps=%d/%d\n"
+		 "  bytes_per_frame=%d\n",
+		 config->format, config->bitrate, config->fps.numerator,
+		 config->fps.denominator, config->bytes_per_frame);
+
+	instance = mse_instance_get(index);
+	if (!instance) {
+		mse_err("instance is not opened. index=%d\n", index);
+		return -EPERM;
+	}
 
-	instance = &mse->instance_table[index];
+	ret = __mse_set_video_config(instance, index, config);
+	mse_instance_put(instance);
 
+	return ret;
+}
+EXPORT_SYMBOL(mse_set_video_config);
+
+static int __mse_get_mpeg2ts_config(struct mse_instance *instance,
+				    int index,
+				    struct mse_mpeg2ts_config *config)
+{
 	mse_debug_state(instance);
 
 	/* state is CLOSE */
@@ -3942,15 +4944,10 @@ int mse_get_mpeg2ts_config(int index, struct mse_mpeg2ts_config *config)
 
 	return 0;
 }
-EXPORT_SYMBOL(mse_get_mpeg2ts_config);
 
-int mse_set_mpeg2ts_config(int index, struct mse_mpeg2ts_config *config)
+int mse_get_mpeg2ts_config(int index, struct mse_mpeg2ts_config *config)
 {
 	struct mse_instance *instance;
-	struct mse_network_config *net_config;
-	struct mse_packetizer_ops *packetizer;
-	struct mse_adapter_network_ops *network;
-	int index_packetizer, index_network;
 	int ret;
 
 	if ((index < 0) || (index >= MSE_INSTANCE_MAX)) {
@@ -3963,7 +4960,30 @@ int mse_set_mpeg2ts_config(int index, struct mse_mpeg2ts_config *config)
 		return -EINVAL;
 	}
 
-	instance = &mse->instance_table[index];
+	mse_debug("index=%d data=%p\n", index, config);
+
+	instance = mse_instance_get(index);
+	if (!instance) {
+		mse_err("instance is not opened. index=%d\n", index);
+		return -EPERM;
+	}
+
+	ret = __mse_get_mpeg2ts_config(instance, index, config);
+	mse_instance_put(instance);
+
+	return ret;
+}
+EXPORT_SYMBOL(mse_get_mpeg2ts_config);
+
+static int __mse_set_mpeg2ts_config(struct mse_instance *instance,
+				    int index,
+				    struct mse_mpeg2ts_config *config)
+{
+	struct mse_network_config *net_config;
+	struct mse_packetizer_ops *packetizer;
+	struct mse_adapter_network_ops *network;
+	int index_packetizer, index_network;
+	int ret;
 
 	mse_debug_state(instance);
 
@@ -4013,10 +5033,12 @@ int mse_set_mpeg2ts_config(int index, struct mse_mpeg2ts_config *config)
 		if (ret < 0)
 			return ret;
 
-		ret = network->set_cbs_param(index_network, &cbs);
+		ret = mse_network_set_cbs_param(instance, &cbs);
 		if (ret < 0)
 			return ret;
 
+		mse_cbs_adapt_init(instance, &cbs);
+
 		mse_debug("bandwidth fraction = %08x\n",
 			  cbs.bandwidth_fraction);
 	} else {
@@ -4026,10 +5048,37 @@ int mse_set_mpeg2ts_config(int index, struct mse_mpeg2ts_config *config)
 			return ret;
 	}
 
-	/* set config */
-	memcpy(&instance->media_config.mpeg2ts, config, sizeof(*config));
+	/* set config */
+	memcpy(&instance->media_config.mpeg2ts, config, sizeof(*config));
+
+	return 0;
+}
+
+int mse_set_mpeg2ts_config(int index, struct mse_mpeg2ts_config *config)
+{
+	struct mse_instance *instance;
+	int ret;
+
+	if ((index < 0) || (index >= MSE_INSTANCE_MAX)) {
+		mse_err("invalid argument. index=%d\n", index);
+		return -EINVAL;
+	}
+
+	if (!config) {
+		mse_err("invalid argument. config\n");
+		return -EINVAL;
+	}
+
+	instance = mse_instance_get(index);
+	if (!instance) {
+		mse_err("instance is not opened. index=%d\n", index);
+		return -EPERM;
+	}
+
+	ret = __mse_set_mpeg2ts_config(instance, index, config);
+	mse_instance_put(instance);
 
-	return 0;
+	return ret;
 }
 EXPORT_SYMBOL(mse_set_mpeg2ts_config);
 
@@ -4051,6 +5100,45 @@ static int check_mch_config(struct mse_instance *instance)
 	return 0; /* Valid */
 }
 
+/* free transmission buffer pool */
+static void trans_buffer_free(struct mse_instance *instance)
+{
+	INIT_LIST_HEAD(&instance->free_buf_list);
+	kfree(instance->trans_buffer);
+	instance->trans_buffer = NULL;
+	instance->trans_buf_num = 0;
+}
+
+/* allocate transmission buffer pool */
+static int trans_buffer_alloc(struct mse_instance *instance)
+{
+	struct mse_trans_buffer *bufs;
+	int acceptable, num, i;
+
+	acceptable = clamp_t(int, trans_buffers, 1,
+			     MSE_TRANS_BUF_ACCEPTABLE_MAX);
+	/*
+	 * batched periods are accepted beyond the configured depth, and
+	 * one spare for a buffer being returned by completion.
+	 */
+	num = max_t(int, acceptable, MSE_TRANS_PERIODS_MAX) + 1;
+
+	bufs = kcalloc(num, sizeof(*bufs), GFP_KERNEL);
+	if (!bufs)
+		return -ENOMEM;
+
+	INIT_LIST_HEAD(&instance->free_buf_list);
+	for (i = 0; i < num; i++)
+		list_add_tail(&bufs[i].list, &instance->free_buf_list);
+
+	instance->trans_buffer = bufs;
+	instance->trans_buf_num = num;
+	instance->trans_buf_acceptable = acceptable;
+	instance->trans_buf_depth = acceptable;
+
+	return 0;
+}
+
 /* free packet buffer */
 static void packet_buffer_free(struct mse_instance *instance)
 {
@@ -4093,6 +5181,101 @@ static int packet_buffer_prepare(struct mse_instance *instance)
 						instance->network);
 }
 
+/* let network adapter launch packets at AVTP time - max transit time */
+static void launch_time_setup(struct mse_instance *instance)
+{
+	struct mse_adapter_network_ops *network = instance->network;
+	int ret;
+
+	instance->f_launch_time = false;
+	if (!instance->tx || !launch_time || !network->set_launch_time)
+		return;
+
+	ret = network->set_launch_time(instance->index_network, true);
+	if (ret) {
+		mse_info("launch time is not supported by %s (%d)\n",
+			 network->name, ret);
+		return;
+	}
+
+	instance->packet_buffer->launch_lead =
+		max(launch_time_lead_us, 0) * NSEC_PER_USEC;
+	instance->f_launch_time = true;
+}
+
+static void fanout_network_cleanup(struct mse_instance *instance)
+{
+	struct mse_packet_ctrl *dma = instance->packet_buffer;
+	int i;
+
+	for (i = 0; i < dma->fanout_num; i++)
+		dma->fanout[i].ops->release(dma->fanout[i].index);
+
+	dma->fanout_num = 0;
+}
+
+/* open destinations sending the same packets with their own header */
+static int fanout_network_setup(struct mse_instance *instance)
+{
+	struct mse_adapter_network_ops *network = instance->network;
+	struct mse_network_device *network_device =
+		&instance->media->config.network_device;
+	struct mse_avtp_tx_fanout fanout;
+	struct mse_avtp_tx_fanout_dest *dest;
+	char *dev_name;
+	int i, ret, index_network;
+
+	if (!instance->tx)
+		return 0;
+
+	ret = mse_config_get_avtp_tx_fanout(instance->index_media, &fanout);
+	if (ret < 0)
+		return ret;
+
+	if (!fanout.num)
+		return 0;
+
+	/*
+	 * fan-out rewrites the header in the ring after each send, it
+	 * needs an adapter which does not send from the ring later.
+	 */
+	if (!network->f_send_copy) {
+		mse_err("fan-out is not supported by %s\n", network->name);
+		return -EOPNOTSUPP;
+	}
+
+	for (i = 0; i < fanout.num; i++) {
+		dest = &fanout.dest[i];
+		if (dest->device_name_tx[0])
+			dev_name = dest->device_name_tx;
+		else
+			dev_name = network_device->device_name_tx;
+
+		index_network = network->open(dev_name);
+		if (index_network < 0) {
+			ret = index_network;
+			goto error_cannot_open;
+		}
+
+		ret = mse_packet_ctrl_add_fanout(instance->packet_buffer,
+						 index_network,
+						 network,
+						 &dest->param);
+		if (ret < 0) {
+			network->release(index_network);
+			goto error_cannot_open;
+		}
+	}
+
+	return 0;
+
+error_cannot_open:
+	mse_err("cannot open fan-out %d ret=%d\n", i, ret);
+	fanout_network_cleanup(instance);
+
+	return ret;
+}
+
 static void crf_network_cleanup(struct mse_instance *instance)
 {
 	if (instance->crf_index_network < 0)
@@ -4226,24 +5409,34 @@ int mse_open(int index_media, bool tx)
 		return -ENODEV;
 	}
 
-	for (i = 0; i < ARRAY_SIZE(mse->instance_table); i++) {
-		if (mse->instance_table[i].state == MSE_STATE_CLOSE)
-			break;
+	instance = kmem_cache_zalloc(mse->instance_cache, GFP_KERNEL);
+	if (!instance) {
+		mutex_unlock(&mse->mutex_open);
+		return -ENOMEM;
 	}
-	index = i;
 
-	if (ARRAY_SIZE(mse->instance_table) <= index) {
+	/* reserve index, instance is published when it is ready */
+	index = idr_alloc(&mse->instance_idr, NULL, 0, MSE_INSTANCE_MAX,
+			  GFP_KERNEL);
+	if (index < 0) {
 		mse_err("resister instance full!\n");
+		kmem_cache_free(mse->instance_cache, instance);
 		mutex_unlock(&mse->mutex_open);
 		return -EBUSY;
 	}
 
-	instance = &mse->instance_table[index];
+	instance->index_media = MSE_INDEX_UNDEFINED;
+	instance->index_network = MSE_INDEX_UNDEFINED;
+	instance->crf_index_network = MSE_INDEX_UNDEFINED;
+	instance->index_packetizer = MSE_INDEX_UNDEFINED;
+	instance->mch_index = MSE_INDEX_UNDEFINED;
+	instance->ptp_index = MSE_INDEX_UNDEFINED;
 
 	mse_debug_state(instance);
 	instance->state = MSE_STATE_OPEN;
 	instance->used_f = true;
-	instance->trans_idx = 0;
+	refcount_set(&instance->refs, 1);
+	init_completion(&instance->completion_release);
 	init_completion(&instance->completion_stop);
 	complete(&instance->completion_stop);
 	atomic_set(&instance->trans_buf_cnt, 0);
@@ -4256,6 +5449,7 @@ int mse_open(int index_media, bool tx)
 	rwlock_init(&instance->lock_stream);
 	spin_lock_init(&instance->lock_timer);
 	spin_lock_init(&instance->lock_ques);
+	spin_lock_init(&instance->lock_pacing);
 	spin_lock_init(&instance->lock_buf_list);
 	sema_init(&instance->sem_stopping, 1);
 
@@ -4295,15 +5489,6 @@ int mse_open(int index_media, bool tx)
 		goto error_packetizer_is_not_valid;
 	}
 
-	/* if mpeg2ts tx */
-	if (tx && IS_MSE_TYPE_MPEG2TS(adapter->type)) {
-		err = mpeg2ts_buffer_alloc(instance);
-		if (err) {
-			mse_err("cannot allocate mpeg2ts_buffer\n");
-			goto error_cannot_alloc_mpeg2ts_buffer;
-		}
-	}
-
 	/* open network adapter */
 	if (tx)
 		dev_name = network_device->device_name_tx;
@@ -4400,31 +5585,20 @@ int mse_open(int index_media, bool tx)
 
 	/* open PTP capture and PTP Timer */
 	if (instance->f_ptp_capture) {
-		/* ptp open */
-		instance->ptp_handle = mse_ptp_open(instance->ptp_index);
-		if (!instance->ptp_handle) {
-			mse_err("cannot mse_ptp_open()\n");
+		/* ptp capture, shared with other instances */
+		instance->capture_hub =
+			mse_capture_hub_get(instance->ptp_index,
+					    instance->ptp_clock_device,
+					    instance->ptp_clock_ch,
+					    instance->ptp_capture_freq);
+		if (!instance->capture_hub) {
 			err = -ENODEV;
 
 			goto error_cannot_open_ptp;
 		}
 
-		mse_info("mse_ptp_capture_start %d %p %d %zu\n",
-			 instance->ptp_index,
-			 instance->ptp_handle,
-			 instance->ptp_clock_ch,
-			 ARRAY_SIZE(instance->timestamps));
-
-		ret = mse_ptp_capture_start(instance->ptp_index,
-					    instance->ptp_handle,
-					    instance->ptp_clock_ch,
-					    ARRAY_SIZE(instance->timestamps));
-		if (ret < 0) {
-			mse_err("cannot mse_ptp_capture_start()\n");
-			err = ret;
-
-			goto error_cannot_ptp_capture_start;
-		}
+		instance->ptp_capture_pos = smp_load_acquire(
+			&instance->capture_hub->ring->head);
 
 		ptp_timer_handle = mse_ptp_timer_open(instance->ptp_index,
 						      mse_ptp_timer_callback,
@@ -4477,6 +5651,11 @@ int mse_open(int index_media, bool tx)
 				    true);
 	}
 
+	/* allocate transmission buffer pool */
+	err = trans_buffer_alloc(instance);
+	if (err)
+		goto error_trans_buffer_alloc;
+
 	/* allocate packet buffer */
 	err = packet_buffer_alloc(instance);
 	if (err)
@@ -4487,6 +5666,13 @@ int mse_open(int index_media, bool tx)
 	if (err)
 		goto error_packet_buffer_prepare;
 
+	launch_time_setup(instance);
+
+	/* send same packets to additional destinations */
+	err = fanout_network_setup(instance);
+	if (err)
+		goto error_fanout_network_setup;
+
 	/* send clock using CRF */
 	if (instance->crf_type == MSE_CRF_TYPE_TX)
 		err = crf_tx_network_setup(instance);
@@ -4504,16 +5690,26 @@ int mse_open(int index_media, bool tx)
 	if (err)
 		goto error_packetizer_init;
 
+	mutex_lock(&mse->mutex_open);
+	idr_replace(&mse->instance_idr, instance, index);
+	mutex_unlock(&mse->mutex_open);
+
 	return index;
 
 error_packetizer_init:
 	crf_network_cleanup(instance);
 
 error_cannot_crf_network_setup:
+	fanout_network_cleanup(instance);
+
+error_fanout_network_setup:
 error_packet_buffer_prepare:
 	packet_buffer_free(instance);
 
 error_packet_buffer_alloc:
+	trans_buffer_free(instance);
+
+error_trans_buffer_alloc:
 	if (m_ops)
 		m_ops->close(instance->mch_handle);
 
@@ -4525,14 +5721,9 @@ error_mch_config_invalid:
 				    instance->ptp_timer_handle);
 	instance->ptp_timer_handle = NULL;
 
-	if (instance->ptp_handle)
-		mse_ptp_capture_stop(instance->ptp_index,
-				     instance->ptp_handle);
-
-error_cannot_ptp_capture_start:
-	if (instance->ptp_handle)
-		mse_ptp_close(instance->ptp_index, instance->ptp_handle);
-	instance->ptp_handle = NULL;
+	if (instance->capture_hub)
+		mse_capture_hub_put(instance->capture_hub);
+	instance->capture_hub = NULL;
 
 error_cannot_open_ptp:
 error_cannot_get_default_config:
@@ -4550,14 +5741,13 @@ error_network_interface_is_link_down:
 	network->release(instance->index_network);
 
 error_cannot_open_network_adapter:
-	mpeg2ts_buffer_free(instance);
-
-error_cannot_alloc_mpeg2ts_buffer:
 error_packetizer_is_not_valid:
 error_network_adapter_not_found:
-	instance->state = MSE_STATE_CLOSE;
-	instance->used_f = false;
+	mutex_lock(&mse->mutex_open);
+	idr_remove(&mse->instance_idr, index);
+	kmem_cache_free(mse->instance_cache, instance);
 	adapter->ro_config_f = false;
+	mutex_unlock(&mse->mutex_open);
 
 	return err;
 }
@@ -4579,7 +5769,12 @@ int mse_close(int index)
 
 	mse_debug("index=%d\n", index);
 
-	instance = &mse->instance_table[index];
+	instance = mse_instance_get(index);
+	if (!instance) {
+		mse_err("instance is not opened. index=%d\n", index);
+		return -EPERM;
+	}
+
 	adapter = instance->media;
 
 	write_lock_irqsave(&instance->lock_state, flags);
@@ -4599,6 +5794,7 @@ int mse_close(int index)
 		if (mse_state_test_nolock(instance, MSE_STATE_STARTED)) {
 			write_unlock_irqrestore(&instance->lock_state, flags);
 			mse_err("instance is busy. index=%d\n", index);
+			mse_instance_put(instance);
 			return -EBUSY;
 		}
 	}
@@ -4607,16 +5803,26 @@ int mse_close(int index)
 	if (mse_state_test_nolock(instance, MSE_STATE_CLOSE)) {
 		write_unlock_irqrestore(&instance->lock_state, flags);
 		mse_err("operation is not permitted. index=%d\n", index);
+		mse_instance_put(instance);
 		return -EPERM;
 	}
 
 	err = mse_state_change(instance, MSE_STATE_CLOSE);
 	write_unlock_irqrestore(&instance->lock_state, flags);
-	if (err)
+	if (err) {
+		mse_instance_put(instance);
 		return err;
+	}
 
 	mutex_lock(&mse->mutex_open);
 
+	/* no more lookup, then wait for callers still using instance */
+	idr_remove(&mse->instance_idr, index);
+	synchronize_rcu();
+	refcount_dec(&instance->refs);
+	mse_instance_put(instance);
+	wait_for_completion(&instance->completion_release);
+
 	/* flush workqueue */
 	flush_workqueue(instance->wq_packet);
 	flush_workqueue(instance->wq_stream);
@@ -4634,10 +5840,13 @@ int mse_close(int index)
 			       instance->index_packetizer);
 
 	/* release network adapter */
+	fanout_network_cleanup(instance);
 	instance->network->release(instance->index_network);
 
 	/* free packet buffer */
 	packet_buffer_free(instance);
+	audio_buffer_free(instance);
+	trans_buffer_free(instance);
 
 	mse_release_crf_packetizer(instance);
 
@@ -4652,37 +5861,27 @@ int mse_close(int index)
 		instance->ptp_timer_handle = NULL;
 	}
 
-	if (instance->ptp_handle) {
-		if (mse_ptp_capture_stop(instance->ptp_index,
-					 instance->ptp_handle) < 0)
-			mse_err("cannot mse_ptp_capture_stop()\n");
-
-		if (mse_ptp_close(instance->ptp_index,
-				  instance->ptp_handle) < 0)
-			mse_err("cannot mse_ptp_close()\n");
-
-		instance->ptp_handle = NULL;
+	if (instance->capture_hub) {
+		mse_capture_hub_put(instance->capture_hub);
+		instance->capture_hub = NULL;
 	}
 
 	if (instance->mch_index >= 0) {
+		if (instance->mch_stats_cycles)
+			mse_info("index=%d mch cycles=%llu avg=%lluns max=%lluns\n",
+				 index, instance->mch_stats_cycles,
+				 div64_u64(instance->mch_stats_time_total,
+					   instance->mch_stats_cycles),
+				 instance->mch_stats_time_max);
+
 		m_ops = mse->mch_table[instance->mch_index];
 		ret = m_ops->close(instance->mch_handle);
 		if (ret < 0)
 			mse_err("mch close error(%d).\n", ret);
 	}
 
-	mpeg2ts_buffer_free(instance);
-
 	/* set table */
-	memset(instance, 0, sizeof(*instance));
-	instance->used_f = false;
-	instance->state = MSE_STATE_CLOSE;
-	instance->index_media = MSE_INDEX_UNDEFINED;
-	instance->index_network = MSE_INDEX_UNDEFINED;
-	instance->crf_index_network = MSE_INDEX_UNDEFINED;
-	instance->index_packetizer = MSE_INDEX_UNDEFINED;
-	instance->mch_index = MSE_INDEX_UNDEFINED;
-	instance->ptp_index = MSE_INDEX_UNDEFINED;
+	kmem_cache_free(mse->instance_cache, instance);
 	adapter->ro_config_f = false;
 
 	mutex_unlock(&mse->mutex_open);
@@ -4691,23 +5890,14 @@ int mse_close(int index)
 }
 EXPORT_SYMBOL(mse_close);
 
-int mse_start_streaming(int index)
+static int __mse_start_streaming(struct mse_instance *instance,
+				 int index)
 {
 	int err = -EINVAL;
-	struct mse_instance *instance;
 	u64 now = 0;
 	unsigned long flags;
 	u32 std;
 
-	if ((index < 0) || (index >= MSE_INSTANCE_MAX)) {
-		mse_err("invalid argument. index=%d\n", index);
-		return err;
-	}
-
-	mse_debug("index=%d\n", index);
-
-	instance = &mse->instance_table[index];
-
 	mse_debug_state(instance);
 
 	down(&instance->sem_stopping);
@@ -4754,11 +5944,11 @@ int mse_start_streaming(int index)
 
 	return err;
 }
-EXPORT_SYMBOL(mse_start_streaming);
 
-int mse_stop_streaming(int index)
+int mse_start_streaming(int index)
 {
 	struct mse_instance *instance;
+	int ret;
 
 	if ((index < 0) || (index >= MSE_INSTANCE_MAX)) {
 		mse_err("invalid argument. index=%d\n", index);
@@ -4766,8 +5956,23 @@ int mse_stop_streaming(int index)
 	}
 
 	mse_debug("index=%d\n", index);
-	instance = &mse->instance_table[index];
 
+	instance = mse_instance_get(index);
+	if (!instance) {
+		mse_err("instance is not opened. index=%d\n", index);
+		return -EPERM;
+	}
+
+	ret = __mse_start_streaming(instance, index);
+	mse_instance_put(instance);
+
+	return ret;
+}
+EXPORT_SYMBOL(mse_start_streaming);
+
+static int __mse_stop_streaming(struct mse_instance *instance,
+				int index)
+{
 	mse_debug_state(instance);
 
 	/* state is NOT STARTED */
@@ -4784,39 +5989,47 @@ int mse_stop_streaming(int index)
 
 	return 0;
 }
-EXPORT_SYMBOL(mse_stop_streaming);
 
-int mse_start_transmission(int index,
-			   void *buffer,
-			   size_t buffer_size,
-			   void *priv,
-			   int (*mse_completion)(void *priv, int size))
+int mse_stop_streaming(int index)
 {
-	int err = -EINVAL;
 	struct mse_instance *instance;
-	struct mse_trans_buffer *buf;
-	int buf_cnt;
-	int idx;
-	unsigned long flags;
+	int ret;
 
 	if ((index < 0) || (index >= MSE_INSTANCE_MAX)) {
 		mse_err("invalid argument. index=%d\n", index);
-		return err;
+		return -EINVAL;
 	}
 
-	if (!buffer) {
-		mse_err("invalid argument. buffer is NULL\n");
-		return err;
+	mse_debug("index=%d\n", index);
+	instance = mse_instance_get(index);
+	if (!instance) {
+		mse_err("instance is not opened. index=%d\n", index);
+		return -EPERM;
 	}
 
-	if (!buffer_size) {
-		mse_err("invalid argument. buffer_size is zero\n");
-		return err;
-	}
+	ret = __mse_stop_streaming(instance, index);
+	mse_instance_put(instance);
 
-	mse_debug("index=%d buffer=%p size=%zu\n", index, buffer, buffer_size);
+	return ret;
+}
+EXPORT_SYMBOL(mse_stop_streaming);
 
-	instance = &mse->instance_table[index];
+static int __mse_start_transmission_common(
+				struct mse_instance *instance,
+				int index,
+				void *buffer,
+				size_t buffer_size,
+				int periods,
+				int acceptable,
+				bool partial,
+				void *priv,
+				int (*mse_completion)(void *priv, int size))
+{
+	int err = -EINVAL;
+	struct mse_trans_buffer *buf;
+	int buf_cnt;
+	int i;
+	unsigned long flags;
 
 	write_lock_irqsave(&instance->lock_state, flags);
 	mse_debug_state(instance);
@@ -4841,23 +6054,36 @@ int mse_start_transmission(int index,
 	write_unlock_irqrestore(&instance->lock_state, flags);
 
 	if (!err) {
+		/* batched periods may exceed the configured depth */
+		acceptable = max(acceptable, instance->trans_buf_acceptable);
 		buf_cnt = atomic_read(&instance->trans_buf_cnt);
-		if (buf_cnt >= MSE_TRANS_BUF_ACCEPTABLE)
+		if (buf_cnt + periods > acceptable)
 			return -EAGAIN;
 
+		/* one buffer per period, completed separately */
 		spin_lock_irqsave(&instance->lock_buf_list, flags);
-		idx = instance->trans_idx;
-		buf = &instance->trans_buffer[idx];
-		buf->media_buffer = buffer;
-		buf->buffer = NULL;
-		buf->buffer_size = buffer_size;
-		buf->work_length = 0;
-		buf->private_data = priv;
-		buf->mse_completion = mse_completion;
-		instance->trans_idx = (idx + 1) % MSE_TRANS_BUF_NUM;
-
-		list_add_tail(&buf->list, &instance->trans_buf_list);
-		atomic_inc(&instance->trans_buf_cnt);
+		for (i = 0; i < periods; i++) {
+			buf = list_first_entry_or_null(&instance->free_buf_list,
+						       struct mse_trans_buffer,
+						       list);
+			if (!buf) {
+				/* not happen, pool covers acceptable */
+				mse_err("no free transmission buffer\n");
+				err = -EAGAIN;
+				break;
+			}
+
+			buf->media_buffer = buffer + buffer_size * i;
+			buf->buffer = NULL;
+			buf->buffer_size = buffer_size;
+			buf->work_length = 0;
+			buf->private_data = priv;
+			buf->mse_completion = mse_completion;
+			buf->partial = partial;
+
+			list_move_tail(&buf->list, &instance->trans_buf_list);
+			atomic_inc(&instance->trans_buf_cnt);
+		}
 
 		spin_unlock_irqrestore(&instance->lock_buf_list, flags);
 		queue_work(instance->wq_packet, &instance->wk_start_trans);
@@ -4865,8 +6091,141 @@ int mse_start_transmission(int index,
 
 	return err;
 }
+
+static int mse_start_transmission_common(
+				int index,
+				void *buffer,
+				size_t buffer_size,
+				int periods,
+				int acceptable,
+				bool partial,
+				void *priv,
+				int (*mse_completion)(void *priv, int size))
+{
+	struct mse_instance *instance;
+	int err = -EINVAL;
+	int ret;
+
+	if ((index < 0) || (index >= MSE_INSTANCE_MAX)) {
+		mse_err("invalid argument. index=%d\n", index);
+		return err;
+	}
+
+	if (!buffer) {
+		mse_err("invalid argument. buffer is NULL\n");
+		return err;
+	}
+
+	if (!buffer_size) {
+		mse_err("invalid argument. buffer_size is zero\n");
+		return err;
+	}
+
+	mse_debug("index=%d buffer=%p size=%zu periods=%d\n",
+		  index, buffer, buffer_size, periods);
+
+	instance = mse_instance_get(index);
+	if (!instance) {
+		mse_err("instance is not opened. index=%d\n", index);
+		return -EPERM;
+	}
+
+	ret = __mse_start_transmission_common(instance, index, buffer,
+					      buffer_size, periods, acceptable,
+					      partial, priv, mse_completion);
+	mse_instance_put(instance);
+
+	return ret;
+}
+
+int mse_start_transmission(int index,
+			   void *buffer,
+			   size_t buffer_size,
+			   void *priv,
+			   int (*mse_completion)(void *priv, int size))
+{
+	return mse_start_transmission_common(index, buffer, buffer_size, 1,
+					     0, false, priv, mse_completion);
+}
 EXPORT_SYMBOL(mse_start_transmission);
 
+int mse_start_transmission_frame(int index,
+				 void *buffer,
+				 size_t buffer_size,
+				 bool frame_end,
+				 void *priv,
+				 int (*mse_completion)(void *priv, int size))
+{
+	return mse_start_transmission_common(index, buffer, buffer_size, 1,
+					     0, !frame_end, priv,
+					     mse_completion);
+}
+EXPORT_SYMBOL(mse_start_transmission_frame);
+
+int mse_start_transmission_periods(int index,
+				   void *buffer,
+				   size_t period_size,
+				   int periods,
+				   void *priv,
+				   int (*mse_completion)(void *priv,
+							 int size))
+{
+	if (periods <= 0 || periods > MSE_TRANS_PERIODS_MAX) {
+		mse_err("invalid argument. periods=%d\n", periods);
+		return -EINVAL;
+	}
+
+	return mse_start_transmission_common(index, buffer, period_size,
+					     periods, MSE_TRANS_PERIODS_MAX,
+					     false, priv, mse_completion);
+}
+EXPORT_SYMBOL(mse_start_transmission_periods);
+
+bool mse_is_frame_end(int index)
+{
+	struct mse_instance *instance;
+	bool frame_end;
+
+	if ((index < 0) || (index >= MSE_INSTANCE_MAX)) {
+		mse_err("invalid argument. index=%d\n", index);
+		return true;
+	}
+
+	instance = mse_instance_get(index);
+	if (!instance)
+		return true;
+
+	frame_end = instance->f_frame_end;
+	mse_instance_put(instance);
+
+	return frame_end;
+}
+EXPORT_SYMBOL(mse_is_frame_end);
+
+int mse_set_trans_depth(int index, int depth)
+{
+	struct mse_instance *instance;
+
+	if ((index < 0) || (index >= MSE_INSTANCE_MAX) || depth < 1) {
+		mse_err("invalid argument. index=%d depth=%d\n",
+			index, depth);
+		return -EINVAL;
+	}
+
+	instance = mse_instance_get(index);
+	if (!instance) {
+		mse_err("instance is not opened. index=%d\n", index);
+		return -EPERM;
+	}
+
+	/* held buffers are flushed before adapter runs out of buffers */
+	instance->trans_buf_depth = min(depth, instance->trans_buf_acceptable);
+	mse_instance_put(instance);
+
+	return 0;
+}
+EXPORT_SYMBOL(mse_set_trans_depth);
+
 int mse_register_mch(struct mch_ops *ops)
 {
 	int index;
@@ -4901,6 +6260,7 @@ EXPORT_SYMBOL(mse_register_mch);
 
 int mse_unregister_mch(int index)
 {
+	struct mse_instance *instance;
 	int i;
 	unsigned long flags;
 
@@ -4911,12 +6271,15 @@ int mse_unregister_mch(int index)
 
 	mse_debug("index=%d\n", index);
 
-	for (i = 0; i < ARRAY_SIZE(mse->instance_table); i++) {
-		if (mse->instance_table[i].mch_index == index) {
+	mutex_lock(&mse->mutex_open);
+	idr_for_each_entry(&mse->instance_idr, instance, i) {
+		if (instance->mch_index == index) {
+			mutex_unlock(&mse->mutex_open);
 			mse_err("module is in use. instance=%d\n", i);
 			return -EPERM;
 		}
 	}
+	mutex_unlock(&mse->mutex_open);
 
 	spin_lock_irqsave(&mse->lock_tables, flags);
 	mse->mch_table[index] = NULL;
@@ -4961,6 +6324,7 @@ EXPORT_SYMBOL(mse_register_ptp);
 
 int mse_unregister_ptp(int index)
 {
+	struct mse_instance *instance;
 	int i;
 	unsigned long flags;
 
@@ -4971,12 +6335,15 @@ int mse_unregister_ptp(int index)
 
 	mse_debug("index=%d\n", index);
 
-	for (i = 0; i < ARRAY_SIZE(mse->instance_table); i++) {
-		if (mse->instance_table[i].ptp_index == index) {
+	mutex_lock(&mse->mutex_open);
+	idr_for_each_entry(&mse->instance_idr, instance, i) {
+		if (instance->ptp_index == index) {
+			mutex_unlock(&mse->mutex_open);
 			mse_err("module is in use. instance=%d\n", i);
 			return -EPERM;
 		}
 	}
+	mutex_unlock(&mse->mutex_open);
 
 	spin_lock_irqsave(&mse->lock_tables, flags);
 	mse->ptp_table[index] = NULL;
@@ -5001,6 +6368,17 @@ static int mse_probe(void)
 
 	spin_lock_init(&mse->lock_tables);
 	mutex_init(&mse->mutex_open);
+	mutex_init(&mse->mutex_capture_hub);
+	idr_init(&mse->instance_idr);
+
+	/* instance is allocated on open */
+	mse->instance_cache = kmem_cache_create("mse_instance",
+						sizeof(struct mse_instance),
+						0, 0, NULL);
+	if (!mse->instance_cache) {
+		kfree(mse);
+		return -ENOMEM;
+	}
 
 	/* register platform device */
 	mse->pdev = platform_device_register_simple("mse", -1, NULL, 0);
@@ -5043,16 +6421,6 @@ static int mse_probe(void)
 	}
 
 	/* init table */
-	for (i = 0; i < ARRAY_SIZE(mse->instance_table); i++) {
-		mse->instance_table[i].state = MSE_STATE_CLOSE;
-		mse->instance_table[i].index_media = MSE_INDEX_UNDEFINED;
-		mse->instance_table[i].index_network = MSE_INDEX_UNDEFINED;
-		mse->instance_table[i].crf_index_network = MSE_INDEX_UNDEFINED;
-		mse->instance_table[i].index_packetizer = MSE_INDEX_UNDEFINED;
-		mse->instance_table[i].mch_index = MSE_INDEX_UNDEFINED;
-		mse->instance_table[i].ptp_index = MSE_INDEX_UNDEFINED;
-	}
-
 	for (i = 0; i < ARRAY_SIZE(mse->media_table); i++)
 		mse->media_table[i].index = MSE_INDEX_UNDEFINED;
 
@@ -5068,6 +6436,7 @@ error:
 		if (mse->pdev)
 			platform_device_unregister(mse->pdev);
 
+		kmem_cache_destroy(mse->instance_cache);
 		kfree(mse);
 	}
 
@@ -5087,6 +6456,8 @@ static int mse_remove(void)
 	/* unregister platform device */
 	platform_device_unregister(mse->pdev);
 	/* release device data */
+	idr_destroy(&mse->instance_idr);
+	kmem_cache_destroy(mse->instance_cache);
 	kfree(mse);
 
 	mse_debug("success\n");
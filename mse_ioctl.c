@@ -217,6 +217,39 @@ static long mse_ioctl_get_avtp_tx_param(struct file *file, unsigned long param)
 	return 0;
 }
 
+static long mse_ioctl_set_avtp_tx_fanout(struct file *file,
+					 unsigned long param)
+{
+	struct mse_avtp_tx_fanout data;
+	char __user *buf = (char __user *)param;
+
+	mse_debug("START\n");
+
+	if (copy_from_user(&data, buf, sizeof(data)))
+		return -EFAULT;
+
+	return mse_config_set_avtp_tx_fanout(iminor(file->f_inode), &data);
+}
+
+static long mse_ioctl_get_avtp_tx_fanout(struct file *file,
+					 unsigned long param)
+{
+	struct mse_avtp_tx_fanout data;
+	char __user *buf = (char __user *)param;
+	int ret;
+
+	mse_debug("START\n");
+
+	ret = mse_config_get_avtp_tx_fanout(iminor(file->f_inode), &data);
+	if (ret)
+		return ret;
+
+	if (copy_to_user(buf, &data, sizeof(data)))
+		return -EFAULT;
+
+	return 0;
+}
+
 static long mse_ioctl_set_avtp_rx_param(struct file *file, unsigned long param)
 {
 	struct mse_avtp_rx_param data;
@@ -345,6 +378,41 @@ static long mse_ioctl_get_mpeg2ts_config(struct file *file,
 	return 0;
 }
 
+static long mse_ioctl_set_mpeg2ts_pid_filter(struct file *file,
+					     unsigned long param)
+{
+	struct mse_media_mpeg2ts_pid_filter data;
+	char __user *buf = (char __user *)param;
+
+	mse_debug("START\n");
+
+	if (copy_from_user(&data, buf, sizeof(data)))
+		return -EFAULT;
+
+	return mse_config_set_media_mpeg2ts_pid_filter(iminor(file->f_inode),
+						       &data);
+}
+
+static long mse_ioctl_get_mpeg2ts_pid_filter(struct file *file,
+					     unsigned long param)
+{
+	struct mse_media_mpeg2ts_pid_filter data;
+	char __user *buf = (char __user *)param;
+	int ret;
+
+	mse_debug("START\n");
+
+	ret = mse_config_get_media_mpeg2ts_pid_filter(iminor(file->f_inode),
+						      &data);
+	if (ret)
+		return ret;
+
+	if (copy_to_user(buf, &data, sizeof(data)))
+		return -EFAULT;
+
+	return 0;
+}
+
 static long mse_ioctl_set_ptp_config(struct file *file, unsigned long param)
 {
 	struct mse_ptp_config data;
@@ -523,6 +591,10 @@ static long mse_ioctl_common(struct file *file,
 		return mse_ioctl_set_avtp_tx_param(file, param);
 	case MSE_G_AVTP_TX_PARAM:
 		return mse_ioctl_get_avtp_tx_param(file, param);
+	case MSE_S_AVTP_TX_FANOUT:
+		return mse_ioctl_set_avtp_tx_fanout(file, param);
+	case MSE_G_AVTP_TX_FANOUT:
+		return mse_ioctl_get_avtp_tx_fanout(file, param);
 	case MSE_S_AVTP_RX_PARAM:
 		return mse_ioctl_set_avtp_rx_param(file, param);
 	case MSE_G_AVTP_RX_PARAM:
@@ -539,6 +611,10 @@ static long mse_ioctl_common(struct file *file,
 		return mse_ioctl_set_mpeg2ts_config(file, param);
 	case MSE_G_MEDIA_MPEG2TS_CONFIG:
 		return mse_ioctl_get_mpeg2ts_config(file, param);
+	case MSE_S_MEDIA_MPEG2TS_PID_FILTER:
+		return mse_ioctl_set_mpeg2ts_pid_filter(file, param);
+	case MSE_G_MEDIA_MPEG2TS_PID_FILTER:
+		return mse_ioctl_get_mpeg2ts_pid_filter(file, param);
 	case MSE_S_PTP_CONFIG:
 		return mse_ioctl_set_ptp_config(file, param);
 	case MSE_G_PTP_CONFIG:
@@ -574,6 +650,8 @@ static long mse_ioctl_audio(struct file *file,
 	case MSE_G_MEDIA_VIDEO_CONFIG:
 	case MSE_S_MEDIA_MPEG2TS_CONFIG:
 	case MSE_G_MEDIA_MPEG2TS_CONFIG:
+	case MSE_S_MEDIA_MPEG2TS_PID_FILTER:
+	case MSE_G_MEDIA_MPEG2TS_PID_FILTER:
 		return -EPERM;
 	default:
 		return mse_ioctl_common(file, cmd, param);
@@ -589,6 +667,8 @@ static long mse_ioctl_video(struct file *file,
 	case MSE_G_MEDIA_AUDIO_CONFIG:
 	case MSE_S_MEDIA_MPEG2TS_CONFIG:
 	case MSE_G_MEDIA_MPEG2TS_CONFIG:
+	case MSE_S_MEDIA_MPEG2TS_PID_FILTER:
+	case MSE_G_MEDIA_MPEG2TS_PID_FILTER:
 	case MSE_S_MCH_CONFIG:
 	case MSE_G_MCH_CONFIG:
 	case MSE_S_AVTP_TX_PARAM_CRF:
@@ -69,9 +69,9 @@
 #include <linux/if_vlan.h>
 
 #include "ravb_mse_kernel.h"
+#include "avtp.h"
 #include "mse_packetizer.h"
 #include "mse_packet_ctrl.h"
-#include "avtp.h"
 
 #define MSE_DMA_BUF_RECEIVE_SIZE 10
 #define MSE_DMA_BUF_SEND_SIZE 10
@@ -112,6 +112,11 @@ struct mse_packet_ctrl *mse_packet_ctrl_alloc(struct device *dev,
 	dma->size = max_packet;
 	dma->write_p = 0;
 	dma->read_p = 0;
+	dma->sent_bytes = 0;
+	dma->launch_now = 0;
+	dma->launch_offset = 0;
+	dma->launch_lead = 0;
+	dma->fanout_num = 0;
 	dma->max_packet_size = max_packet_size;
 	dma->packet_table = kmalloc((sizeof(struct mse_packet) * dma->size),
 				    GFP_KERNEL);
@@ -122,6 +127,7 @@ struct mse_packet_ctrl *mse_packet_ctrl_alloc(struct device *dev,
 		dma->packet_table[i].len = dma->max_packet_size;
 		dma->packet_table[i].paddr = paddr + pitch;
 		dma->packet_table[i].vaddr = dma->dma_vaddr + pitch;
+		dma->packet_table[i].launch_time = 0;
 	}
 
 	return dma;
@@ -142,6 +148,23 @@ void mse_packet_ctrl_free(struct mse_packet_ctrl *dma)
 	kfree(dma);
 }
 
+/* extend 32bit AVTP timestamp around launch_now and subtract transit time */
+static u64 mse_packet_ctrl_calc_launch_time(struct mse_packet_ctrl *dma,
+					    unsigned int timestamp)
+{
+	u32 launch = timestamp - dma->launch_offset;
+	u64 launch_time;
+
+	if (!dma->launch_now)
+		return 0;
+
+	launch_time = dma->launch_now + (s32)(launch - (u32)dma->launch_now);
+	if (launch_time < dma->launch_now + dma->launch_lead)
+		launch_time = dma->launch_now + dma->launch_lead;
+
+	return launch_time;
+}
+
 int mse_packet_ctrl_make_packet(int index,
 				void *data,
 				size_t size,
@@ -200,6 +223,9 @@ int mse_packet_ctrl_make_packet(int index,
 			if (packet_size < AVTP_FRAME_SIZE_MIN)
 				packet_size = AVTP_FRAME_SIZE_MIN;
 			dma->packet_table[dma->write_p].len = packet_size;
+			dma->packet_table[dma->write_p].launch_time =
+				mse_packet_ctrl_calc_launch_time(dma,
+								 timestamp);
 
 			dma->write_p = new_write_p;
 		} else if (ret < 0) {
@@ -262,15 +288,75 @@ int mse_packet_ctrl_send_prepare_packet(
 				 dma->size);
 }
 
+int mse_packet_ctrl_add_fanout(struct mse_packet_ctrl *dma,
+			       int index,
+			       struct mse_adapter_network_ops *ops,
+			       struct mse_avtp_tx_param *param)
+{
+	struct mse_packet_fanout *fanout;
+	int ret;
+
+	if (dma->fanout_num >= ARRAY_SIZE(dma->fanout))
+		return -ENOSPC;
+
+	ret = ops->send_prepare(index, dma->packet_table, dma->size);
+	if (ret < 0)
+		return ret;
+
+	fanout = &dma->fanout[dma->fanout_num++];
+	fanout->index = index;
+	fanout->ops = ops;
+
+	set_ieee8021q_dest(fanout->header, param->dst_mac);
+	set_ieee8021q_source(fanout->header, param->src_mac);
+	set_ieee8021q_tpid(fanout->header, ETH_P_8021Q);
+	set_ieee8021q_tci(fanout->header,
+			  (param->priority << VLAN_PRIO_SHIFT) | param->vlan);
+	avtp_make_streamid(fanout->streamid, (char *)param->src_mac,
+			   param->uniqueid);
+
+	return 0;
+}
+
+/*
+ * send packets already sent by main stream with header of each fan-out.
+ * Only for adapters with f_send_copy, others still use the ring.
+ */
+static void mse_packet_ctrl_send_fanout(struct mse_packet_ctrl *dma,
+					int num)
+{
+	struct mse_packet_fanout *fanout;
+	u8 *vaddr;
+	int i, j, ret;
+
+	for (i = 0; i < dma->fanout_num; i++) {
+		fanout = &dma->fanout[i];
+
+		for (j = 0; j < num; j++) {
+			vaddr = dma->packet_table[
+				(dma->read_p + j) % dma->size].vaddr;
+			memcpy(vaddr, fanout->header, sizeof(fanout->header));
+			avtp_set_stream_id(vaddr, fanout->streamid);
+		}
+
+		ret = fanout->ops->send(fanout->index, dma->packet_table, num);
+		if (ret != num)
+			mse_err("fan-out %d send is short %d/%d\n",
+				i, ret, num);
+	}
+}
+
 int mse_packet_ctrl_send_packet(int index,
+				int max_size,
 				struct mse_packet_ctrl *dma,
 				struct mse_adapter_network_ops *ops)
 {
 	int read_p, ret, send_size;
 	int packetized;
+	int i;
 
 	packetized = mse_packet_ctrl_check_packet_remain(dma);
-	send_size = min(packetized, MSE_PACKET_COUNT_MAX);
+	send_size = min3(packetized, max_size, MSE_PACKET_COUNT_MAX);
 
 	if (!send_size)
 		return 0;
@@ -280,13 +366,21 @@ int mse_packet_ctrl_send_packet(int index,
 	if (ret < 0)
 		return -EPERM;
 
+	if (ret > 0 && dma->fanout_num)
+		mse_packet_ctrl_send_fanout(dma, ret);
+
+	/* count bytes on wire, same basis as the CBS bandwidth */
+	for (i = 0; i < ret; i++)
+		dma->sent_bytes += ETHERNET_OVERHEAD +
+			dma->packet_table[(dma->read_p + i) % dma->size].len;
+
 	read_p = dma->read_p; /* for debug */
 	dma->read_p = (dma->read_p + ret) % dma->size;
 
 	mse_debug("%d packtets w=%d r=%d->%d\n",
 		  ret, dma->write_p, read_p, dma->read_p);
 
-	return 0;
+	return ret;
 }
 
 int mse_packet_ctrl_receive_prepare_packet(
@@ -379,7 +473,8 @@ int mse_packet_ctrl_take_out_packet(int index,
 				    int *t_stored,
 				    struct mse_packet_ctrl *dma,
 				    struct mse_packetizer_ops *ops,
-				    size_t *processed)
+				    size_t *processed,
+				    bool *partial)
 {
 	int ret = MSE_PACKETIZE_STATUS_CONTINUE;
 	unsigned int recv_time;
@@ -415,7 +510,8 @@ int mse_packet_ctrl_take_out_packet(int index,
 			(*t_stored)++;
 		}
 
-		if (ret == MSE_PACKETIZE_STATUS_COMPLETE)
+		if (ret == MSE_PACKETIZE_STATUS_COMPLETE ||
+		    ret == MSE_PACKETIZE_STATUS_PARTIAL)
 			break;
 
 		/* update received count */
@@ -430,6 +526,9 @@ int mse_packet_ctrl_take_out_packet(int index,
 		return -EAGAIN;
 	}
 
+	if (partial)
+		*partial = (ret == MSE_PACKETIZE_STATUS_PARTIAL);
+
 	return *processed;
 }
 
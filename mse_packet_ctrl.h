@@ -62,6 +62,15 @@
 #ifndef __MSE_PACKET_CTRL_H__
 #define __MSE_PACKET_CTRL_H__
 
+/* destination sharing the packets with rewritten header */
+struct mse_packet_fanout {
+	int index;
+	struct mse_adapter_network_ops *ops;
+	/* DA + SA + Q-Tag */
+	u8 header[AVTP_OFFSET - 2];
+	u8 streamid[AVTP_STREAMID_SIZE];
+};
+
 struct mse_packet_ctrl {
 	struct device *dev;
 	int size;
@@ -71,6 +80,16 @@ struct mse_packet_ctrl {
 	dma_addr_t dma_handle;
 	void *dma_vaddr;
 	struct mse_packet *packet_table;
+	u64 sent_bytes;
+	/* gPTP time at packetize, 0 disables launch time */
+	u64 launch_now;
+	/* AVTP timestamp minus this is the launch time */
+	u32 launch_offset;
+	/* launch time is at least this later than launch_now */
+	u32 launch_lead;
+	/* talker fan-out, sent with the packets of main stream */
+	struct mse_packet_fanout fanout[MSE_CONFIG_FANOUT_MAX];
+	int fanout_num;
 };
 
 int mse_packet_ctrl_check_packet_remain(struct mse_packet_ctrl *dma);
@@ -91,7 +110,12 @@ int mse_packet_ctrl_make_packet(int index,
 int mse_packet_ctrl_send_prepare_packet(int index,
 					struct mse_packet_ctrl *dma,
 					struct mse_adapter_network_ops *ops);
+int mse_packet_ctrl_add_fanout(struct mse_packet_ctrl *dma,
+			       int index,
+			       struct mse_adapter_network_ops *ops,
+			       struct mse_avtp_tx_param *param);
 int mse_packet_ctrl_send_packet(int index,
+				int max_size,
 				struct mse_packet_ctrl *dma,
 				struct mse_adapter_network_ops *ops);
 int mse_packet_ctrl_receive_prepare_packet(int index,
@@ -113,7 +137,8 @@ int mse_packet_ctrl_take_out_packet(int index,
 				    int *t_stored,
 				    struct mse_packet_ctrl *dma,
 				    struct mse_packetizer_ops *ops,
-				    size_t *processed);
+				    size_t *processed,
+				    bool *partial);
 int mse_packet_ctrl_make_packet_crf(int index,
 				    u64 *timestamps,
 				    int count,
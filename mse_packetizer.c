@@ -61,13 +61,13 @@
 
 #include <linux/module.h>
 #include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
 
 #include "ravb_mse_kernel.h"
 #include "mse_packetizer.h"
 #include "avtp.h"
 
-/* preamble (8) + FCS (4) */
-#define ETHERNET_OVERHEAD             (8 + 4)
 #define CBS_ADJUST_RATIO_BASE_PERCENT (100)
 #define BIT_TO_BYTE                   (8)
 #define TRANSMIT_RATE_BASE            (1000)
@@ -80,7 +80,7 @@ struct mse_packetizer_ops_table {
 	struct mse_packetizer_ops *ops;
 };
 
-DEFINE_SPINLOCK(packetizer_lock);
+static DEFINE_MUTEX(packetizer_lock);
 
 static const struct mse_packetizer_ops_table
 packetizer_table[MSE_PACKETIZER_MAX] = {
@@ -321,6 +321,7 @@ int mse_packetizer_stats_init(struct mse_packetizer_stats *stats)
 	stats->seq_num_next = SEQNUM_INIT;
 	stats->seq_num_err = SEQNUM_INIT;
 	stats->seq_num_err_total = 0;
+	stats->filtered_total = 0;
 
 	return 0;
 }
@@ -364,22 +365,55 @@ int mse_packetizer_stats_report(struct mse_packetizer_stats *stats)
 		mse_err("sequence number discontinuity total=%llu\n",
 			stats->seq_num_err_total);
 
+	if (stats->filtered_total)
+		mse_info("filtered packets total=%llu\n",
+			 stats->filtered_total);
+
 	return 0;
 }
 
+/* allocate private data of packetizer, return index of it */
+int mse_packetizer_idr_alloc(struct idr *idr, size_t size, void **priv)
+{
+	void *data;
+	int index;
+
+	data = kzalloc(size, GFP_KERNEL);
+	if (!data)
+		return -ENOMEM;
+
+	index = idr_alloc(idr, data, 0, MSE_INSTANCE_MAX, GFP_KERNEL);
+	if (index < 0) {
+		kfree(data);
+		return -EPERM;
+	}
+
+	*priv = data;
+
+	return index;
+}
+
+void mse_packetizer_idr_free(struct idr *idr, int index)
+{
+	void *data;
+
+	data = idr_find(idr, index);
+	idr_remove(idr, index);
+	kfree(data);
+}
+
 int mse_packetizer_open(enum MSE_PACKETIZER id)
 {
 	struct mse_packetizer_ops *ops;
 	int ret;
-	unsigned long flags;
 
 	ops = mse_packetizer_get_ops(id);
 	if (!ops)
 		return -EPERM;
 
-	spin_lock_irqsave(&packetizer_lock, flags);
+	mutex_lock(&packetizer_lock);
 	ret = ops->open();
-	spin_unlock_irqrestore(&packetizer_lock, flags);
+	mutex_unlock(&packetizer_lock);
 
 	return ret;
 }
@@ -388,15 +422,14 @@ int mse_packetizer_release(enum MSE_PACKETIZER id, int index)
 {
 	struct mse_packetizer_ops *ops;
 	int ret;
-	unsigned long flags;
 
 	ops = mse_packetizer_get_ops(id);
 	if (!ops)
 		return -EPERM;
 
-	spin_lock_irqsave(&packetizer_lock, flags);
+	mutex_lock(&packetizer_lock);
 	ret = ops->release(index);
-	spin_unlock_irqrestore(&packetizer_lock, flags);
+	mutex_unlock(&packetizer_lock);
 
 	return ret;
 }
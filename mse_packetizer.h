@@ -62,12 +62,17 @@
 #ifndef __MSE_PACKETIZER_H__
 #define __MSE_PACKETIZER_H__
 
+#include <linux/idr.h>
+#include <linux/rcupdate.h>
+
 #define NSEC_SCALE              (1000000000UL)
 #define SEQNUM_INIT             (-1)
 #define DEFAULT_INTERVAL_FRAMES (8000) /* class A */
 #define CRF_INTERVAL_FRAMES     (50) /* CRF AVTPDUs per Second */
 #define AVTP_PAYLOAD_MAX (ETHFRAMELEN_MAX - AVTP_PAYLOAD_OFFSET)
 #define JPEG_PAYLOAD_MAX (ETHFRAMELEN_MAX - AVTP_CVF_MJPEG_PAYLOAD_OFFSET)
+/* preamble (8) + FCS (4) */
+#define ETHERNET_OVERHEAD       (8 + 4)
 
 /**
  * @brief packetizer status
@@ -78,6 +83,7 @@ enum MSE_PACKETIZE_STATUS  {
 	MSE_PACKETIZE_STATUS_MAY_COMPLETE,
 	MSE_PACKETIZE_STATUS_NOT_ENOUGH,
 	MSE_PACKETIZE_STATUS_SKIP,
+	MSE_PACKETIZE_STATUS_PARTIAL,
 };
 
 /**
@@ -87,6 +93,7 @@ struct mse_packetizer_stats {
 	s32 seq_num_next;
 	u32 seq_num_err;
 	u64 seq_num_err_total;
+	u64 filtered_total;
 };
 
 /**
@@ -151,6 +158,9 @@ struct mse_packetizer_ops {
 	int (*set_start_time)(int index,
 			      struct mse_start_time *start_time);
 
+	/** @brief set whether media buffer ends a frame, optional */
+	int (*set_frame_end)(int index, bool frame_end);
+
 	/** @brief calc_cbs function pointer */
 	int (*calc_cbs)(int index, struct mse_cbsparam *cbs);
 
@@ -212,6 +222,24 @@ u32 mse_packetizer_calc_audio_offset(u32 avtp_timestamp,
 int mse_packetizer_stats_init(struct mse_packetizer_stats *stats);
 int mse_packetizer_stats_seqnum(struct mse_packetizer_stats *stats, u8 seq_num);
 int mse_packetizer_stats_report(struct mse_packetizer_stats *stats);
+int mse_packetizer_idr_alloc(struct idr *idr, size_t size, void **priv);
+void mse_packetizer_idr_free(struct idr *idr, int index);
+
+/*
+ * find private data of packetizer. IDR is walked under RCU, as open and
+ * release of other indexes may change it. The data itself stays until
+ * release, which core calls after all users of the index are stopped.
+ */
+static inline void *mse_packetizer_idr_find(struct idr *idr, int index)
+{
+	void *data;
+
+	rcu_read_lock();
+	data = idr_find(idr, index);
+	rcu_read_unlock();
+
+	return data;
+}
 int mse_packetizer_open(enum MSE_PACKETIZER id);
 int mse_packetizer_release(enum MSE_PACKETIZER id, int index);
 
@@ -87,7 +87,6 @@ struct avtp_aaf_param {
 };
 
 struct aaf_packetizer {
-	bool used_f;
 	bool piece_f;
 
 	int send_seq_num;
@@ -113,7 +112,7 @@ struct aaf_packetizer {
 	struct mse_packetizer_stats stats;
 };
 
-struct aaf_packetizer aaf_packetizer_table[MSE_INSTANCE_MAX];
+static DEFINE_IDR(aaf_packetizer_idr);
 
 static enum AVTP_AAF_FORMAT get_aaf_format(enum MSE_AUDIO_BIT bit_depth)
 {
@@ -160,7 +159,8 @@ static int get_aaf_format_size(int aaf_format)
 static int check_receive_packet(int index, int channels,
 				int sample_rate, int bit_depth)
 {
-	struct aaf_packetizer *aaf = &aaf_packetizer_table[index];
+	struct aaf_packetizer *aaf =
+		mse_packetizer_idr_find(&aaf_packetizer_idr, index);
 	struct mse_audio_config *audio_config = &aaf->audio_config;
 
 	if (channels != audio_config->channels) {
@@ -195,10 +195,10 @@ static int check_packet_format(int index)
 	enum MSE_AUDIO_BIT sample_bit_depth;
 	int bytes_per_sample, bit_depth, sample_rate, channels;
 
-	if (index >= ARRAY_SIZE(aaf_packetizer_table))
+	aaf = mse_packetizer_idr_find(&aaf_packetizer_idr, index);
+	if (!aaf)
 		return -EPERM;
 
-	aaf = &aaf_packetizer_table[index];
 	audio_config = &aaf->audio_config;
 
 	sample_bit_depth = audio_config->sample_bit_depth;
@@ -265,16 +265,11 @@ static int mse_packetizer_aaf_open(void)
 	struct aaf_packetizer *aaf;
 	int index;
 
-	for (index = 0; aaf_packetizer_table[index].used_f &&
-	     index < ARRAY_SIZE(aaf_packetizer_table); index++)
-		;
+	index = mse_packetizer_idr_alloc(&aaf_packetizer_idr,
+					 sizeof(*aaf), (void **)&aaf);
+	if (index < 0)
+		return index;
 
-	if (index >= ARRAY_SIZE(aaf_packetizer_table))
-		return -EPERM;
-
-	aaf = &aaf_packetizer_table[index];
-
-	aaf->used_f = true;
 	aaf->piece_f = false;
 	aaf->send_seq_num = 0;
 	aaf->piece_data_len = 0;
@@ -290,15 +285,15 @@ static int mse_packetizer_aaf_release(int index)
 {
 	struct aaf_packetizer *aaf;
 
-	if (index >= ARRAY_SIZE(aaf_packetizer_table))
+	aaf = mse_packetizer_idr_find(&aaf_packetizer_idr, index);
+	if (!aaf)
 		return -EPERM;
 
-	aaf = &aaf_packetizer_table[index];
 	mse_debug("index=%d\n", index);
 
 	mse_packetizer_stats_report(&aaf->stats);
 
-	memset(aaf, 0, sizeof(*aaf));
+	mse_packetizer_idr_free(&aaf_packetizer_idr, index);
 
 	return 0;
 }
@@ -307,11 +302,10 @@ static int mse_packetizer_aaf_packet_init(int index)
 {
 	struct aaf_packetizer *aaf;
 
-	if (index >= ARRAY_SIZE(aaf_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
-	aaf = &aaf_packetizer_table[index];
+	aaf = mse_packetizer_idr_find(&aaf_packetizer_idr, index);
+	if (!aaf)
+		return -EPERM;
 
 	aaf->piece_f = false;
 	aaf->send_seq_num = 0;
@@ -331,11 +325,11 @@ static int mse_packetizer_aaf_set_network_config(
 {
 	struct aaf_packetizer *aaf;
 
-	if (index >= ARRAY_SIZE(aaf_packetizer_table))
+	mse_debug("index=%d\n", index);
+	aaf = mse_packetizer_idr_find(&aaf_packetizer_idr, index);
+	if (!aaf)
 		return -EPERM;
 
-	mse_debug("index=%d\n", index);
-	aaf = &aaf_packetizer_table[index];
 	aaf->net_config = *config;
 
 	return 0;
@@ -386,13 +380,13 @@ static int mse_packetizer_aaf_set_audio_config(int index,
 	int payload_size;
 	int ret;
 
-	if (index >= ARRAY_SIZE(aaf_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d rate=%d channels=%d samples_per_frame=%d\n",
 		  index, config->sample_rate, config->channels,
 		  config->samples_per_frame);
-	aaf = &aaf_packetizer_table[index];
+	aaf = mse_packetizer_idr_find(&aaf_packetizer_idr, index);
+	if (!aaf)
+		return -EPERM;
+
 	aaf->audio_config = *config;
 
 	ret = check_packet_format(index);
@@ -447,11 +441,10 @@ static int mse_packetizer_aaf_get_audio_info(int index,
 {
 	struct aaf_packetizer *aaf;
 
-	if (index >= ARRAY_SIZE(aaf_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
-	aaf = &aaf_packetizer_table[index];
+	aaf = mse_packetizer_idr_find(&aaf_packetizer_idr, index);
+	if (!aaf)
+		return -EPERM;
 
 	info->avtp_packet_size = aaf->avtp_packet_size;
 	info->sample_per_packet = aaf->sample_per_packet;
@@ -465,11 +458,10 @@ static int mse_packetizer_aaf_calc_cbs(int index,
 {
 	struct aaf_packetizer *aaf;
 
-	if (index >= ARRAY_SIZE(aaf_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
-	aaf = &aaf_packetizer_table[index];
+	aaf = mse_packetizer_idr_find(&aaf_packetizer_idr, index);
+	if (!aaf)
+		return -EPERM;
 
 	return mse_packetizer_calc_cbs_by_frames(
 			aaf->net_config.port_transmit_rate,
@@ -636,10 +628,10 @@ static int mse_packetizer_aaf_packetize(int index,
 	int count, dest_byte, readed_byte;
 	struct mse_audio_config *config;
 
-	if (index >= ARRAY_SIZE(aaf_packetizer_table))
+	aaf = mse_packetizer_idr_find(&aaf_packetizer_idr, index);
+	if (!aaf)
 		return -EPERM;
 
-	aaf = &aaf_packetizer_table[index];
 	config = &aaf->audio_config;
 	mse_debug("index=%d seqnum=%d process=%zu/%zu t=%d\n",
 		  index, aaf->send_seq_num, *buffer_processed,
@@ -711,22 +703,23 @@ static int mse_packetizer_aaf_depacketize(int index,
 					  size_t packet_size)
 {
 	struct aaf_packetizer *aaf;
-	int payload_size, piece_size = 0;
+	int payload_size;
 	u32 offset;
-	char *buf, tmp_buffer[ETHFRAMEMTU_MAX] = {0};
+	unsigned char *payload;
+	size_t room;
+	int bytes_per_sample, head;
 	int aaf_format;
 	int aaf_bit_depth;
 	int aaf_byte_per_ch;
 	int aaf_sample_rate;
 	int channels;
-	int count, stored;
+	int count, in_count, stored;
 	int ret;
 
-	if (index >= ARRAY_SIZE(aaf_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
-	aaf = &aaf_packetizer_table[index];
+	aaf = mse_packetizer_idr_find(&aaf_packetizer_idr, index);
+	if (!aaf)
+		return -EPERM;
 
 	if (avtp_get_subtype(packet) != AVTP_SUBTYPE_AAF) {
 		mse_err("error subtype=%d\n", avtp_get_subtype(packet));
@@ -779,41 +772,44 @@ static int mse_packetizer_aaf_depacketize(int index,
 		*buffer_processed += offset;
 	}
 
-	/* buffer over check */
-	count = payload_size / aaf_byte_per_ch;
-	if (*buffer_processed + count * aaf->audio_config.bytes_per_sample >
-	    buffer_size)
-		buf = tmp_buffer;
-	else
-		buf = buffer + *buffer_processed;
-
 	/* seq_num check */
 	mse_packetizer_stats_seqnum(&aaf->stats, avtp_get_sequence_num(packet));
 
-	copy_buffer(buf, &stored,
-		    packet + AVTP_AAF_PAYLOAD_OFFSET,
-		    aaf_byte_per_ch, aaf,
-		    count);
+	/* samples fit in buffer are converted into it directly */
+	bytes_per_sample = aaf->audio_config.bytes_per_sample;
+	payload = packet + AVTP_AAF_PAYLOAD_OFFSET;
+	count = payload_size / aaf_byte_per_ch;
+	room = buffer_size - *buffer_processed;
+	in_count = min_t(size_t, count, room / bytes_per_sample);
+
+	copy_buffer(buffer + *buffer_processed, &stored,
+		    payload, aaf_byte_per_ch, aaf, in_count);
+	*buffer_processed += stored;
+
+	/* buffer over, rest samples are kept for next buffer */
+	if (in_count < count) {
+		copy_buffer(aaf->packet_piece, &stored,
+			    payload + in_count * aaf_byte_per_ch,
+			    aaf_byte_per_ch, aaf, count - in_count);
+
+		/* head of the sample straddling the end of buffer */
+		head = buffer_size - *buffer_processed;
+		if (head) {
+			memcpy(buffer + *buffer_processed,
+			       aaf->packet_piece, head);
+			memmove(aaf->packet_piece, aaf->packet_piece + head,
+				stored - head);
+		}
 
-	if (*buffer_processed + count * aaf->audio_config.bytes_per_sample >
-	    buffer_size) {
 		aaf->piece_f = true;
-		piece_size = buffer_size - *buffer_processed;
-		aaf->piece_data_len = stored - piece_size;
-		memcpy(buffer + *buffer_processed, buf, piece_size);
-		memcpy(aaf->packet_piece, buf + piece_size,
-		       aaf->piece_data_len);
+		aaf->piece_data_len = stored - head;
+		*buffer_processed = buffer_size;
 		mse_debug("piece %d - %02x %02x %02x %02x\n",
 			  aaf->piece_data_len,
 			  aaf->packet_piece[0], aaf->packet_piece[1],
 			  aaf->packet_piece[2], aaf->packet_piece[3]);
 	}
 
-	if (*buffer_processed + stored > buffer_size)
-		*buffer_processed = buffer_size;
-	else
-		*buffer_processed += stored;
-
 	*timestamp = avtp_get_timestamp(packet);
 
 	/* buffer over check */
@@ -828,10 +824,10 @@ int mse_packetizer_aaf_set_start_time(int index,
 {
 	struct aaf_packetizer *aaf;
 
-	if (index >= ARRAY_SIZE(aaf_packetizer_table))
+	aaf = mse_packetizer_idr_find(&aaf_packetizer_idr, index);
+	if (!aaf)
 		return -EPERM;
 
-	aaf = &aaf_packetizer_table[index];
 	aaf->start_time = *start_time;
 
 	return 0;
@@ -75,6 +75,9 @@
 #define CBS_ADJUSTMENT_FACTOR   (103) /* percent */
 #define MSE_CRFDATA_MAX         (6)
 
+/* fraction bits of timestamp interval in fixed point */
+#define CRF_INTERVAL_SHIFT      (16)
+
 struct avtp_crf_param {
 	char dest_addr[MSE_MAC_LEN_MAX];
 	char source_addr[MSE_MAC_LEN_MAX];
@@ -86,34 +89,35 @@ struct avtp_crf_param {
 };
 
 struct crf_packetizer {
-	bool used_f;
 	int send_seq_num;
 	unsigned char packet_template[ETHFRAMELEN_MAX];
 
 	int crf_packet_size;
 	int frame_interval_time;
+	int timestamps_per_pdu;
+	/* ns between timestamps, fixed point of CRF_INTERVAL_SHIFT */
+	u64 interval_fp;
+
+	/* header of last received packet */
+	u32 rx_base_frequency;
+	u32 rx_timestamp_interval;
 
 	struct mse_network_config net_config;
 	struct mse_audio_config   crf_audio_config;
 };
 
-struct crf_packetizer crf_packetizer_table[MSE_INSTANCE_MAX];
+static DEFINE_IDR(crf_packetizer_idr);
 
 static int mse_packetizer_crf_audio_open(void)
 {
 	struct crf_packetizer *crf;
 	int index;
 
-	for (index = 0; crf_packetizer_table[index].used_f &&
-	     index < ARRAY_SIZE(crf_packetizer_table); index++)
-		;
-
-	if (index >= ARRAY_SIZE(crf_packetizer_table))
-		return -EPERM;
-
-	crf = &crf_packetizer_table[index];
+	index = mse_packetizer_idr_alloc(&crf_packetizer_idr,
+					 sizeof(*crf), (void **)&crf);
+	if (index < 0)
+		return index;
 
-	crf->used_f = true;
 	crf->send_seq_num = 0;
 
 	return index;
@@ -123,12 +127,11 @@ static int mse_packetizer_crf_audio_release(int index)
 {
 	struct crf_packetizer *crf;
 
-	if (index >= ARRAY_SIZE(crf_packetizer_table))
+	crf = mse_packetizer_idr_find(&crf_packetizer_idr, index);
+	if (!crf)
 		return -EPERM;
 
-	crf = &crf_packetizer_table[index];
-
-	memset(crf, 0, sizeof(*crf));
+	mse_packetizer_idr_free(&crf_packetizer_idr, index);
 
 	return 0;
 }
@@ -137,11 +140,10 @@ static int mse_packetizer_crf_audio_packet_init(int index)
 {
 	struct crf_packetizer *crf;
 
-	if (index >= ARRAY_SIZE(crf_packetizer_table))
+	crf = mse_packetizer_idr_find(&crf_packetizer_idr, index);
+	if (!crf)
 		return -EPERM;
 
-	crf = &crf_packetizer_table[index];
-
 	crf->send_seq_num = 0;
 
 	return 0;
@@ -153,13 +155,13 @@ static int mse_packetizer_crf_audio_set_network_config(
 {
 	struct crf_packetizer *crf;
 
-	if (index >= ARRAY_SIZE(crf_packetizer_table))
+	if (!config)
 		return -EPERM;
 
-	if (!config)
+	crf = mse_packetizer_idr_find(&crf_packetizer_idr, index);
+	if (!crf)
 		return -EPERM;
 
-	crf = &crf_packetizer_table[index];
 	crf->net_config = *config;
 
 	return 0;
@@ -207,17 +209,32 @@ static int mse_packetizer_crf_audio_set_audio_config(
 	struct crf_packetizer *crf;
 	struct avtp_crf_param param;
 
-	if (index >= ARRAY_SIZE(crf_packetizer_table))
+	if (!config)
 		return -EPERM;
 
-	if (!config)
+	crf = mse_packetizer_idr_find(&crf_packetizer_idr, index);
+	if (!crf)
 		return -EPERM;
 
-	crf = &crf_packetizer_table[index];
 	crf->crf_audio_config = *config;
 
+	if (config->crf_timestamps_per_pdu > 0)
+		crf->timestamps_per_pdu = min_t(int,
+						config->crf_timestamps_per_pdu,
+						AVTP_CRF_TIMESTAMPS_MAX);
+	else
+		crf->timestamps_per_pdu = MSE_CRFDATA_MAX;
+
 	crf->crf_packet_size = AVTP_CRF_PAYLOAD_OFFSET +
-			       (sizeof(u64) * MSE_CRFDATA_MAX);
+			       (sizeof(u64) * crf->timestamps_per_pdu);
+
+	/* timestamps in packet are spaced by timestamp_interval samples */
+	if (config->sample_rate > 0 && config->samples_per_frame > 0)
+		crf->interval_fp = div64_u64(
+			((u64)config->samples_per_frame * NSEC_SCALE) <<
+			CRF_INTERVAL_SHIFT, config->sample_rate);
+	else
+		crf->interval_fp = 0;
 
 	memcpy(param.dest_addr, crf->net_config.dest_addr, MSE_MAC_LEN_MAX);
 	memcpy(param.source_addr, crf->net_config.source_addr, MSE_MAC_LEN_MAX);
@@ -239,11 +256,10 @@ static int mse_packetizer_crf_audio_get_audio_info(
 {
 	struct crf_packetizer *crf;
 
-	if (index >= ARRAY_SIZE(crf_packetizer_table))
+	crf = mse_packetizer_idr_find(&crf_packetizer_idr, index);
+	if (!crf)
 		return -EPERM;
 
-	crf = &crf_packetizer_table[index];
-
 	info->frame_interval_time = crf->frame_interval_time;
 
 	return 0;
@@ -253,17 +269,27 @@ static int mse_packetizer_crf_audio_calc_cbs(int index,
 					     struct mse_cbsparam *cbs)
 {
 	struct crf_packetizer *crf;
+	struct mse_audio_config *config;
+	int frames;
 
-	if (index >= ARRAY_SIZE(crf_packetizer_table))
+	mse_debug("index=%d\n", index);
+	crf = mse_packetizer_idr_find(&crf_packetizer_idr, index);
+	if (!crf)
 		return -EPERM;
 
-	mse_debug("index=%d\n", index);
-	crf = &crf_packetizer_table[index];
+	/* AVTPDUs per second carrying all timestamps */
+	config = &crf->crf_audio_config;
+	frames = CRF_INTERVAL_FRAMES;
+	if (config->samples_per_frame > 0)
+		frames = max_t(int, frames,
+			       DIV_ROUND_UP(config->sample_rate,
+					    config->samples_per_frame *
+					    crf->timestamps_per_pdu));
 
 	return mse_packetizer_calc_cbs_by_frames(
 			crf->net_config.port_transmit_rate,
 			crf->crf_packet_size,
-			CRF_INTERVAL_FRAMES,
+			frames,
 			CBS_ADJUSTMENT_FACTOR,
 			cbs);
 }
@@ -278,23 +304,37 @@ static int mse_packetizer_crf_audio_packetize(int index,
 {
 	struct crf_packetizer *crf;
 	u64 *ptptimes;
+	u64 base, offset_fp;
 	u64 *sample;
-	int i, data_len;
+	int i, count, data_len;
 
-	if (index >= ARRAY_SIZE(crf_packetizer_table))
+	crf = mse_packetizer_idr_find(&crf_packetizer_idr, index);
+	if (!crf)
 		return -EPERM;
 
-	crf = &crf_packetizer_table[index];
+	/*
+	 * buffer has count measured timestamps. When it has fewer than
+	 * timestamps_per_pdu, the rest are last + k * interval.
+	 */
+	ptptimes = buffer;
+	count = min_t(int, buffer_size / sizeof(u64), crf->timestamps_per_pdu);
+	if (!count)
+		return -EINVAL;
 
 	memcpy(packet, crf->packet_template, AVTP_CRF_PAYLOAD_OFFSET);
 	sample = (u64 *)(packet + AVTP_CRF_PAYLOAD_OFFSET);
-	ptptimes = buffer;
 
-	data_len = 0;
-	for (i = 0; i < buffer_size / sizeof(*ptptimes); i++) {
+	for (i = 0; i < count; i++)
 		*sample++ = cpu_to_be64(ptptimes[i]);
-		data_len += sizeof(*sample);
+
+	base = ptptimes[count - 1];
+	offset_fp = crf->interval_fp;
+	for (; i < crf->timestamps_per_pdu; i++) {
+		*sample++ = cpu_to_be64(base +
+					(offset_fp >> CRF_INTERVAL_SHIFT));
+		offset_fp += crf->interval_fp;
 	}
+	data_len = crf->timestamps_per_pdu * sizeof(u64);
 
 	/* variable header */
 	avtp_set_sequence_num(packet, crf->send_seq_num++);
@@ -314,14 +354,14 @@ static int mse_packetizer_crf_audio_depacketize(int index,
 {
 	u64 *crf_data, *dest;
 	int size, i;
-	unsigned long value;
+	u64 value;
+	u32 base_frequency, timestamp_interval;
 	struct crf_packetizer *crf;
 
-	if (index >= ARRAY_SIZE(crf_packetizer_table))
+	crf = mse_packetizer_idr_find(&crf_packetizer_idr, index);
+	if (!crf)
 		return -EPERM;
 
-	crf = &crf_packetizer_table[index];
-
 	size = avtp_get_crf_data_length(packet);
 
 	if (size > buffer_size) {
@@ -329,9 +369,20 @@ static int mse_packetizer_crf_audio_depacketize(int index,
 		return -ENOMEM;
 	}
 
-	value = NSEC_SCALE * avtp_get_crf_timestamp_interval(packet);
-	do_div(value, avtp_get_crf_base_frequency(packet));
-	crf->frame_interval_time = value;
+	/* interval changes only when the talker is reconfigured */
+	base_frequency = avtp_get_crf_base_frequency(packet);
+	timestamp_interval = avtp_get_crf_timestamp_interval(packet);
+	if (base_frequency != crf->rx_base_frequency ||
+	    timestamp_interval != crf->rx_timestamp_interval) {
+		if (!base_frequency)
+			return -EINVAL;
+
+		value = NSEC_SCALE * (u64)timestamp_interval;
+		do_div(value, base_frequency);
+		crf->frame_interval_time = value;
+		crf->rx_base_frequency = base_frequency;
+		crf->rx_timestamp_interval = timestamp_interval;
+	}
 	crf_data = (u64 *)((char *)packet + AVTP_CRF_PAYLOAD_OFFSET);
 	dest = buffer;
 
@@ -123,6 +123,19 @@ enum NALU_TYPE {
 	NALU_TYPE_UNSPECIFIED31 = 31,
 };
 
+/*
+ * module parameters
+ */
+static bool h264_rx_low_latency;
+module_param(h264_rx_low_latency, bool, 0644);
+MODULE_PARM_DESC(h264_rx_low_latency,
+		 "Complete receive buffer at slice end, before picture end");
+
+static unsigned int h264_rx_low_latency_bytes;
+module_param(h264_rx_low_latency_bytes, uint, 0644);
+MODULE_PARM_DESC(h264_rx_low_latency_bytes,
+		 "Min bytes to complete buffer at slice end (0: each slice)");
+
 struct avtp_cvf_h264_param {
 	char dest_addr[MSE_MAC_LEN_MAX];
 	char source_addr[MSE_MAC_LEN_MAX];
@@ -133,9 +146,10 @@ struct avtp_cvf_h264_param {
 };
 
 struct cvf_h264_packetizer {
-	bool used_f;
 	bool is_vcl;
 	bool f_start_code;
+	bool frame_end;              /* media buffer ends access unit */
+	bool f_partial;              /* picture partially completed */
 
 	int send_seq_num;
 	int header_size;             /* whole header size defined IEEE1722 */
@@ -155,23 +169,20 @@ struct cvf_h264_packetizer {
 	struct mse_packetizer_stats stats;
 };
 
-struct cvf_h264_packetizer cvf_h264_packetizer_table[MSE_INSTANCE_MAX];
+static DEFINE_IDR(cvf_h264_packetizer_idr);
 
 static int mse_packetizer_cvf_h264_open(void)
 {
 	struct cvf_h264_packetizer *h264;
 	int index;
 
-	for (index = 0; cvf_h264_packetizer_table[index].used_f &&
-	     index < ARRAY_SIZE(cvf_h264_packetizer_table); index++)
-		;
-	if (index >= ARRAY_SIZE(cvf_h264_packetizer_table))
-		return -EPERM;
-
-	h264 = &cvf_h264_packetizer_table[index];
+	index = mse_packetizer_idr_alloc(&cvf_h264_packetizer_idr,
+					 sizeof(*h264), (void **)&h264);
+	if (index < 0)
+		return index;
 
-	h264->used_f = true;
 	h264->send_seq_num = 0;
+	h264->frame_end = true;
 	h264->header_size = AVTP_CVF_H264_PAYLOAD_OFFSET;
 	h264->additional_header_size =
 		AVTP_CVF_H264_PAYLOAD_OFFSET - AVTP_PAYLOAD_OFFSET;
@@ -187,16 +198,13 @@ static int mse_packetizer_cvf_h264_d13_open(void)
 	struct cvf_h264_packetizer *h264;
 	int index;
 
-	for (index = 0; cvf_h264_packetizer_table[index].used_f &&
-	     index < ARRAY_SIZE(cvf_h264_packetizer_table); index++)
-		;
-	if (index >= ARRAY_SIZE(cvf_h264_packetizer_table))
-		return -EPERM;
+	index = mse_packetizer_idr_alloc(&cvf_h264_packetizer_idr,
+					 sizeof(*h264), (void **)&h264);
+	if (index < 0)
+		return index;
 
-	h264 = &cvf_h264_packetizer_table[index];
-
-	h264->used_f = true;
 	h264->send_seq_num = 0;
+	h264->frame_end = true;
 	h264->header_size = AVTP_CVF_H264_D13_PAYLOAD_OFFSET;
 	h264->additional_header_size =
 		AVTP_CVF_H264_D13_PAYLOAD_OFFSET - AVTP_PAYLOAD_OFFSET;
@@ -211,15 +219,15 @@ static int mse_packetizer_cvf_h264_release(int index)
 {
 	struct cvf_h264_packetizer *h264;
 
-	if (index >= ARRAY_SIZE(cvf_h264_packetizer_table))
+	h264 = mse_packetizer_idr_find(&cvf_h264_packetizer_idr, index);
+	if (!h264)
 		return -EPERM;
 
-	h264 = &cvf_h264_packetizer_table[index];
 	mse_debug("index=%d\n", index);
 
 	mse_packetizer_stats_report(&h264->stats);
 
-	memset(h264, 0, sizeof(*h264));
+	mse_packetizer_idr_free(&cvf_h264_packetizer_idr, index);
 	return 0;
 }
 
@@ -227,13 +235,14 @@ static int mse_packetizer_cvf_h264_packet_init(int index)
 {
 	struct cvf_h264_packetizer *h264;
 
-	if (index >= ARRAY_SIZE(cvf_h264_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
-	h264 = &cvf_h264_packetizer_table[index];
+	h264 = mse_packetizer_idr_find(&cvf_h264_packetizer_idr, index);
+	if (!h264)
+		return -EPERM;
 
 	h264->send_seq_num = 0;
+	h264->frame_end = true;
+	h264->f_partial = false;
 
 	mse_packetizer_stats_init(&h264->stats);
 
@@ -246,11 +255,11 @@ static int mse_packetizer_cvf_h264_set_network_config(
 {
 	struct cvf_h264_packetizer *h264;
 
-	if (index >= ARRAY_SIZE(cvf_h264_packetizer_table))
+	mse_debug("index=%d\n", index);
+	h264 = mse_packetizer_idr_find(&cvf_h264_packetizer_idr, index);
+	if (!h264)
 		return -EPERM;
 
-	mse_debug("index=%d\n", index);
-	h264 = &cvf_h264_packetizer_table[index];
 	h264->net_config = *config;
 	return 0;
 }
@@ -296,11 +305,11 @@ static int mse_packetizer_cvf_h264_set_video_config(
 	struct avtp_cvf_h264_param param;
 	int bytes_per_frame;
 
-	if (index >= ARRAY_SIZE(cvf_h264_packetizer_table))
+	mse_debug("index=%d\n", index);
+	h264 = mse_packetizer_idr_find(&cvf_h264_packetizer_idr, index);
+	if (!h264)
 		return -EPERM;
 
-	mse_debug("index=%d\n", index);
-	h264 = &cvf_h264_packetizer_table[index];
 	h264->video_config = *config;
 
 	switch (config->format) {
@@ -348,11 +357,10 @@ static int mse_packetizer_cvf_h264_calc_cbs(int index,
 {
 	struct cvf_h264_packetizer *h264;
 
-	if (index >= ARRAY_SIZE(cvf_h264_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
-	h264 = &cvf_h264_packetizer_table[index];
+	h264 = mse_packetizer_idr_find(&cvf_h264_packetizer_idr, index);
+	if (!h264)
+		return -EPERM;
 
 	return mse_packetizer_calc_cbs_by_bitrate(
 			h264->net_config.port_transmit_rate,
@@ -362,6 +370,19 @@ static int mse_packetizer_cvf_h264_calc_cbs(int index,
 			cbs);
 }
 
+static int mse_packetizer_cvf_h264_set_frame_end(int index, bool frame_end)
+{
+	struct cvf_h264_packetizer *h264;
+
+	h264 = mse_packetizer_idr_find(&cvf_h264_packetizer_idr, index);
+	if (!h264)
+		return -EPERM;
+
+	h264->frame_end = frame_end;
+
+	return 0;
+}
+
 static inline bool is_single_nal(u8 fu_indicator)
 {
 	u8 nalu_type = fu_indicator & NALU_TYPE_MASK;
@@ -387,10 +408,10 @@ static int mse_packetizer_cvf_h264_packetize(int index,
 	unsigned char *cur_nal;
 	unsigned char *payload;
 
-	if (index >= ARRAY_SIZE(cvf_h264_packetizer_table))
+	h264 = mse_packetizer_idr_find(&cvf_h264_packetizer_idr, index);
+	if (!h264)
 		return -EPERM;
 
-	h264 = &cvf_h264_packetizer_table[index];
 	mse_debug("index=%d seqnum=%d process=%zu/%zu t=%u\n",
 		  index, h264->send_seq_num, *buffer_processed,
 		  buffer_size, *timestamp);
@@ -478,7 +499,10 @@ static int mse_packetizer_cvf_h264_packetize(int index,
 				    data_len + data_offset +
 				    h264->additional_header_size);
 
-	if (h264->is_vcl && (h264->fu_header & FU_H_E_BIT))
+	/* M bit on last packet of access unit, not on each slice */
+	if (h264->frame_end && h264->is_vcl &&
+	    (h264->fu_header & FU_H_E_BIT) &&
+	    *buffer_processed + data_len >= buffer_size)
 		/* set M bit */
 		((unsigned char *)packet)[MBIT_ADDR] |= MBIT_SET;
 	else
@@ -538,7 +562,7 @@ static bool check_pic_end(struct cvf_h264_packetizer *h264,
 
 	case NALU_TYPE_AUD:
 		h264->is_vcl = false;
-		if (h264->vcl_start)
+		if (h264->vcl_start || h264->f_partial)
 			pic_end = true;
 		break;
 
@@ -568,11 +592,12 @@ static int mse_packetizer_cvf_h264_depacketize(int index,
 	unsigned char *payload;
 	unsigned char fu_indicator, fu_header;
 	bool pic_end = false;
+	bool nal_end = false;
 
-	if (index >= ARRAY_SIZE(cvf_h264_packetizer_table))
+	h264 = mse_packetizer_idr_find(&cvf_h264_packetizer_idr, index);
+	if (!h264)
 		return -EPERM;
 
-	h264 = &cvf_h264_packetizer_table[index];
 	mse_debug("index=%d\n", index);
 	if (avtp_get_subtype(packet) != AVTP_SUBTYPE_CVF) {
 		mse_err("error subtype=%d\n", avtp_get_subtype(packet));
@@ -624,6 +649,7 @@ static int mse_packetizer_cvf_h264_depacketize(int index,
 				set_nal_header(h264, buf, data_len);
 				(*buffer_processed) = data_len;
 				h264->vcl_start = NULL;
+				h264->f_partial = false;
 
 				return MSE_PACKETIZE_STATUS_COMPLETE;
 			}
@@ -633,7 +659,9 @@ static int mse_packetizer_cvf_h264_depacketize(int index,
 		}
 		if (fu_header & FU_H_E_BIT) { /* end */
 			set_nal_header(h264, buf, data_len);
-			if (h264->vcl_start)
+			nal_end = true;
+			/* low latency ends picture only by M bit or AUD */
+			if (h264->vcl_start && !h264_rx_low_latency)
 				pic_end = true;
 
 			if (!pic_end)
@@ -657,6 +685,7 @@ static int mse_packetizer_cvf_h264_depacketize(int index,
 
 		pic_end = check_pic_end(h264, buf, nalu_type);
 		set_nal_header(h264, buf, data_len);
+		nal_end = true;
 	} else {
 		mse_err("unkonwon nal unit = %02x\n",
 			fu_indicator & NALU_TYPE_MASK);
@@ -671,11 +700,23 @@ static int mse_packetizer_cvf_h264_depacketize(int index,
 	if (((unsigned char *)packet)[MBIT_ADDR] & MBIT_SET) /* M bit */
 		pic_end = true;
 
-	if (!pic_end)
+	if (!pic_end) {
+		/* hand slices to decoder before picture end */
+		if (h264_rx_low_latency && nal_end && h264->is_vcl &&
+		    data_len >= h264_rx_low_latency_bytes) {
+			mse_debug("partial size = %zu\n", data_len);
+			/* next buffer continues the same picture */
+			h264->vcl_start = NULL;
+			h264->f_partial = true;
+			return MSE_PACKETIZE_STATUS_PARTIAL;
+		}
+
 		return MSE_PACKETIZE_STATUS_CONTINUE;
+	}
 
 	h264->vcl_start = NULL;
 	h264->is_vcl = false;
+	h264->f_partial = false;
 
 	mse_debug("size = %zu\n", *buffer_processed);
 
@@ -688,6 +729,7 @@ struct mse_packetizer_ops mse_packetizer_cvf_h264_d13_ops = {
 	.init = mse_packetizer_cvf_h264_packet_init,
 	.set_network_config = mse_packetizer_cvf_h264_set_network_config,
 	.set_video_config = mse_packetizer_cvf_h264_set_video_config,
+	.set_frame_end = mse_packetizer_cvf_h264_set_frame_end,
 	.calc_cbs = mse_packetizer_cvf_h264_calc_cbs,
 	.packetize = mse_packetizer_cvf_h264_packetize,
 	.depacketize = mse_packetizer_cvf_h264_depacketize,
@@ -699,6 +741,7 @@ struct mse_packetizer_ops mse_packetizer_cvf_h264_ops = {
 	.init = mse_packetizer_cvf_h264_packet_init,
 	.set_network_config = mse_packetizer_cvf_h264_set_network_config,
 	.set_video_config = mse_packetizer_cvf_h264_set_video_config,
+	.set_frame_end = mse_packetizer_cvf_h264_set_frame_end,
 	.calc_cbs = mse_packetizer_cvf_h264_calc_cbs,
 	.packetize = mse_packetizer_cvf_h264_packetize,
 	.depacketize = mse_packetizer_cvf_h264_depacketize,
@@ -100,7 +100,6 @@ struct jpeg_info {
 };
 
 struct cvf_mjpeg_packetizer {
-	bool used_f;
 
 	struct jpeg_info jpeg;
 
@@ -123,23 +122,19 @@ struct cvf_mjpeg_packetizer {
 	struct mse_packetizer_stats stats;
 };
 
-struct cvf_mjpeg_packetizer cvf_mjpeg_packetizer_table[MSE_INSTANCE_MAX];
+static DEFINE_IDR(cvf_mjpeg_packetizer_idr);
 
 static int mse_packetizer_cvf_mjpeg_open(void)
 {
 	struct cvf_mjpeg_packetizer *cvf_mjpeg;
 	int index;
 
-	for (index = 0; cvf_mjpeg_packetizer_table[index].used_f &&
-	     index < ARRAY_SIZE(cvf_mjpeg_packetizer_table); index++)
-		;
+	index = mse_packetizer_idr_alloc(&cvf_mjpeg_packetizer_idr,
+					 sizeof(*cvf_mjpeg),
+					 (void **)&cvf_mjpeg);
+	if (index < 0)
+		return index;
 
-	if (index >= ARRAY_SIZE(cvf_mjpeg_packetizer_table))
-		return -EPERM;
-
-	cvf_mjpeg = &cvf_mjpeg_packetizer_table[index];
-
-	cvf_mjpeg->used_f = true;
 	cvf_mjpeg->send_seq_num = 0;
 
 	mse_packetizer_stats_init(&cvf_mjpeg->stats);
@@ -153,15 +148,15 @@ static int mse_packetizer_cvf_mjpeg_release(int index)
 {
 	struct cvf_mjpeg_packetizer *cvf_mjpeg;
 
-	if (index >= ARRAY_SIZE(cvf_mjpeg_packetizer_table))
+	cvf_mjpeg = mse_packetizer_idr_find(&cvf_mjpeg_packetizer_idr, index);
+	if (!cvf_mjpeg)
 		return -EPERM;
 
-	cvf_mjpeg = &cvf_mjpeg_packetizer_table[index];
 	mse_debug("index=%d\n", index);
 
 	mse_packetizer_stats_report(&cvf_mjpeg->stats);
 
-	memset(cvf_mjpeg, 0, sizeof(*cvf_mjpeg));
+	mse_packetizer_idr_free(&cvf_mjpeg_packetizer_idr, index);
 
 	return 0;
 }
@@ -178,12 +173,11 @@ static int mse_packetizer_cvf_mjpeg_packet_init(int index)
 {
 	struct cvf_mjpeg_packetizer *cvf_mjpeg;
 
-	if (index >= ARRAY_SIZE(cvf_mjpeg_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
 
-	cvf_mjpeg = &cvf_mjpeg_packetizer_table[index];
+	cvf_mjpeg = mse_packetizer_idr_find(&cvf_mjpeg_packetizer_idr, index);
+	if (!cvf_mjpeg)
+		return -EPERM;
 
 	cvf_mjpeg->send_seq_num = 0;
 	cvf_mjpeg->quant = MJPEG_QUANT_DYNAMIC;
@@ -201,12 +195,12 @@ static int mse_packetizer_cvf_mjpeg_set_network_config(
 {
 	struct cvf_mjpeg_packetizer *cvf_mjpeg;
 
-	if (index >= ARRAY_SIZE(cvf_mjpeg_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
 
-	cvf_mjpeg = &cvf_mjpeg_packetizer_table[index];
+	cvf_mjpeg = mse_packetizer_idr_find(&cvf_mjpeg_packetizer_idr, index);
+	if (!cvf_mjpeg)
+		return -EPERM;
+
 	cvf_mjpeg->net_config = *config;
 
 	return 0;
@@ -258,12 +252,12 @@ static int mse_packetizer_cvf_mjpeg_set_video_config(
 	struct mse_network_config *net_config;
 	int bytes_per_frame;
 
-	if (index >= ARRAY_SIZE(cvf_mjpeg_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
 
-	cvf_mjpeg = &cvf_mjpeg_packetizer_table[index];
+	cvf_mjpeg = mse_packetizer_idr_find(&cvf_mjpeg_packetizer_idr, index);
+	if (!cvf_mjpeg)
+		return -EPERM;
+
 	cvf_mjpeg->video_config = *config;
 	net_config = &cvf_mjpeg->net_config;
 
@@ -299,11 +293,10 @@ static int mse_packetizer_cvf_mjpeg_calc_cbs(int index,
 {
 	struct cvf_mjpeg_packetizer *cvf_mjpeg;
 
-	if (index >= ARRAY_SIZE(cvf_mjpeg_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
-	cvf_mjpeg = &cvf_mjpeg_packetizer_table[index];
+	cvf_mjpeg = mse_packetizer_idr_find(&cvf_mjpeg_packetizer_idr, index);
+	if (!cvf_mjpeg)
+		return -EPERM;
 
 	return mse_packetizer_calc_cbs_by_bitrate(
 			cvf_mjpeg->net_config.port_transmit_rate,
@@ -445,10 +438,10 @@ static int mse_packetizer_cvf_mjpeg_packetize(int index,
 	int i;
 	bool pic_end = false;
 
-	if (index >= ARRAY_SIZE(cvf_mjpeg_packetizer_table))
+	cvf_mjpeg = mse_packetizer_idr_find(&cvf_mjpeg_packetizer_idr, index);
+	if (!cvf_mjpeg)
 		return -EPERM;
 
-	cvf_mjpeg = &cvf_mjpeg_packetizer_table[index];
 	jpeg = &cvf_mjpeg->jpeg;
 
 	mse_debug("index=%d seqnum=%d process=%zu/%zu t=%u\n",
@@ -634,12 +627,11 @@ static int mse_packetizer_cvf_mjpeg_depacketize(int index,
 	u16 dri = 0;
 	u32 offset, width, height;
 
-	if (index >= ARRAY_SIZE(cvf_mjpeg_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
 
-	cvf_mjpeg = &cvf_mjpeg_packetizer_table[index];
+	cvf_mjpeg = mse_packetizer_idr_find(&cvf_mjpeg_packetizer_idr, index);
+	if (!cvf_mjpeg)
+		return -EPERM;
 
 	if (avtp_get_subtype(packet) != AVTP_SUBTYPE_CVF) {
 		mse_err("error subtype=%d\n", avtp_get_subtype(packet));
@@ -708,26 +700,19 @@ static int mse_packetizer_cvf_mjpeg_depacketize(int index,
 
 	/* make header for first data */
 	if (!offset) {
-		u8 header[1024];
-		u32 len;
-
-		memset(header, 0, sizeof(header));
-		len = jpeg_make_header(cvf_mjpeg->type,
-				       cvf_mjpeg->quant,
-				       header,
-				       width,
-				       height,
-				       qt,
-				       &qheader,
-				       dri);
-
-		if (*buffer_processed + len >= buffer_size) {
+		if (*buffer_processed + JPEG_HEADER_SIZE_MAX >= buffer_size) {
 			mse_err("buffer overrun header\n");
 			return -EPERM;
 		}
 
-		memcpy(buffer + *buffer_processed, header, len);
-		*buffer_processed += len;
+		*buffer_processed += jpeg_make_header(cvf_mjpeg->type,
+						      cvf_mjpeg->quant,
+						      buffer + *buffer_processed,
+						      width,
+						      height,
+						      qt,
+						      &qheader,
+						      dri);
 	}
 
 	if (*buffer_processed + data_len >= buffer_size) {
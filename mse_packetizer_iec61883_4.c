@@ -68,6 +68,7 @@
 #include <linux/kernel.h>
 #include <uapi/linux/if_ether.h>
 #include <linux/math64.h>
+#include <linux/bitmap.h>
 
 #include "ravb_mse_kernel.h"
 #include "mse_packetizer.h"
@@ -80,6 +81,10 @@
 #define MSE_M2TS_PACKET_SIZE    (MSE_TIMESTAMP_SIZE + MSE_TS_PACKET_SIZE)
 #define M2TS_FREQ               (27000000)    /* 27MHz */
 #define DEFAULT_DIFF_TIMESTAMP  (NSEC_SCALE / DEFAULT_INTERVAL_FRAMES)
+#define TS_PID_MAX              (8192)
+#define TS_PID_PAT              (0x0000)
+#define TS_TABLE_ID_PAT         (0x00)
+#define TS_CRC_SIZE             (4)
 
 struct avtp_iec61883_4_param {
 	char dest_addr[MSE_MAC_LEN_MAX];
@@ -91,7 +96,6 @@ struct avtp_iec61883_4_param {
 };
 
 struct iec61883_4_packetizer {
-	bool used_f;
 
 	int send_seq_num;
 	int payload_max;
@@ -109,25 +113,24 @@ struct iec61883_4_packetizer {
 	struct mse_network_config net_config;
 	struct mse_mpeg2ts_config mpeg2ts_config;
 	struct mse_packetizer_stats stats;
+
+	bool pid_filter_f;
+	DECLARE_BITMAP(pid_map, TS_PID_MAX);
 };
 
-struct iec61883_4_packetizer iec61883_4_packetizer_table[MSE_INSTANCE_MAX];
+static DEFINE_IDR(iec61883_4_packetizer_idr);
 
 static int mse_packetizer_iec61883_4_open(void)
 {
 	struct iec61883_4_packetizer *iec61883_4;
 	int index;
 
-	for (index = 0; iec61883_4_packetizer_table[index].used_f &&
-	     index < ARRAY_SIZE(iec61883_4_packetizer_table); index++)
-		;
-
-	if (index >= ARRAY_SIZE(iec61883_4_packetizer_table))
-		return -EPERM;
-
-	iec61883_4 = &iec61883_4_packetizer_table[index];
+	index = mse_packetizer_idr_alloc(&iec61883_4_packetizer_idr,
+					 sizeof(*iec61883_4),
+					 (void **)&iec61883_4);
+	if (index < 0)
+		return index;
 
-	iec61883_4->used_f = true;
 	iec61883_4->send_seq_num = 0;
 	iec61883_4->dbc = 0;
 
@@ -141,15 +144,15 @@ static int mse_packetizer_iec61883_4_release(int index)
 {
 	struct iec61883_4_packetizer *iec61883_4;
 
-	if (index >= ARRAY_SIZE(iec61883_4_packetizer_table))
+	iec61883_4 = mse_packetizer_idr_find(&iec61883_4_packetizer_idr, index);
+	if (!iec61883_4)
 		return -EPERM;
 
-	iec61883_4 = &iec61883_4_packetizer_table[index];
 	mse_debug("index=%d\n", index);
 
 	mse_packetizer_stats_report(&iec61883_4->stats);
 
-	memset(iec61883_4, 0, sizeof(*iec61883_4));
+	mse_packetizer_idr_free(&iec61883_4_packetizer_idr, index);
 
 	return 0;
 }
@@ -158,11 +161,10 @@ static int mse_packetizer_iec61883_4_packet_init(int index)
 {
 	struct iec61883_4_packetizer *iec61883_4;
 
-	if (index >= ARRAY_SIZE(iec61883_4_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
-	iec61883_4 = &iec61883_4_packetizer_table[index];
+	iec61883_4 = mse_packetizer_idr_find(&iec61883_4_packetizer_idr, index);
+	if (!iec61883_4)
+		return -EPERM;
 
 	iec61883_4->send_seq_num = 0;
 	iec61883_4->dbc = 0;
@@ -179,12 +181,12 @@ static int mse_packetizer_iec61883_4_set_network_config(
 {
 	struct iec61883_4_packetizer *iec61883_4;
 
-	if (index >= ARRAY_SIZE(iec61883_4_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
 
-	iec61883_4 = &iec61883_4_packetizer_table[index];
+	iec61883_4 = mse_packetizer_idr_find(&iec61883_4_packetizer_idr, index);
+	if (!iec61883_4)
+		return -EPERM;
+
 	iec61883_4->net_config = *config;
 
 	return 0;
@@ -235,14 +237,25 @@ static int mse_packetizer_iec61883_4_set_mpeg2ts_config(
 	struct mse_network_config *net_config;
 	int tspackets_per_frame;
 
-	if (index >= ARRAY_SIZE(iec61883_4_packetizer_table))
+	mse_debug("index=%d\n", index);
+	iec61883_4 = mse_packetizer_idr_find(&iec61883_4_packetizer_idr, index);
+	if (!iec61883_4)
 		return -EPERM;
 
-	mse_debug("index=%d\n", index);
-	iec61883_4 = &iec61883_4_packetizer_table[index];
 	iec61883_4->mpeg2ts_config = *config;
 	net_config = &iec61883_4->net_config;
 
+	/* PID allow-list, PMT PIDs are added from PAT on receive */
+	bitmap_zero(iec61883_4->pid_map, TS_PID_MAX);
+	iec61883_4->pid_filter_f = config->pid_filter_num > 0;
+	if (iec61883_4->pid_filter_f) {
+		int i;
+
+		set_bit(TS_PID_PAT, iec61883_4->pid_map);
+		for (i = 0; i < config->pid_filter_num; i++)
+			set_bit(config->pid_filter[i], iec61883_4->pid_map);
+	}
+
 	tspackets_per_frame = iec61883_4->mpeg2ts_config.tspackets_per_frame;
 	iec61883_4->payload_max = tspackets_per_frame * MSE_TS_PACKET_SIZE;
 	iec61883_4->packet_size = AVTP_IEC61883_4_PAYLOAD_OFFSET +
@@ -267,11 +280,10 @@ static int mse_packetizer_iec61883_4_calc_cbs(int index,
 {
 	struct iec61883_4_packetizer *iec61883_4;
 
-	if (index >= ARRAY_SIZE(iec61883_4_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
-	iec61883_4 = &iec61883_4_packetizer_table[index];
+	iec61883_4 = mse_packetizer_idr_find(&iec61883_4_packetizer_idr, index);
+	if (!iec61883_4)
+		return -EPERM;
 
 	return mse_packetizer_calc_cbs_by_bitrate(
 			iec61883_4->net_config.port_transmit_rate,
@@ -309,10 +321,10 @@ static int mse_packetizer_iec61883_4_packetize(int index,
 	unsigned int num = 0, diff;
 	bool is_top_on_buffer;
 
-	if (index >= ARRAY_SIZE(iec61883_4_packetizer_table))
+	iec61883_4 = mse_packetizer_idr_find(&iec61883_4_packetizer_idr, index);
+	if (!iec61883_4)
 		return -EPERM;
 
-	iec61883_4 = &iec61883_4_packetizer_table[index];
 	mse_debug("index=%d seqnum=%d process=%zu/%zu t=%d\n",
 		  index, iec61883_4->send_seq_num, *buffer_processed,
 		  buffer_size, *timestamp);
@@ -430,6 +442,45 @@ static int mse_packetizer_iec61883_4_packetize(int index,
 	return MSE_PACKETIZE_STATUS_CONTINUE;
 }
 
+static void iec61883_4_parse_pat(struct iec61883_4_packetizer *iec61883_4,
+				 const unsigned char *tsp)
+{
+	const unsigned char *p, *end;
+	const unsigned char *tsp_end = tsp + MSE_TS_PACKET_SIZE;
+	int section_length, program_number, pid;
+
+	/* only PAT section starting in this packet */
+	if (!(tsp[1] & 0x40) || !(tsp[3] & 0x10))
+		return;
+
+	p = tsp + 4;
+	if (tsp[3] & 0x20)
+		p += 1 + p[0];          /* adaptation field */
+	if (p >= tsp_end)
+		return;
+
+	p += 1 + p[0];                  /* pointer field */
+	if (p + 8 > tsp_end || p[0] != TS_TABLE_ID_PAT)
+		return;
+
+	section_length = ((p[1] & 0x0f) << 8) | p[2];
+	end = p + 3 + section_length - TS_CRC_SIZE;
+	if (end > tsp_end)
+		end = tsp_end;
+
+	for (p += 8; p + 4 <= end; p += 4) {
+		program_number = (p[0] << 8) | p[1];
+		pid = ((p[2] & 0x1f) << 8) | p[3];
+
+		/* program 0 is network PID */
+		if (program_number && !test_bit(pid, iec61883_4->pid_map)) {
+			mse_debug("pass PMT pid=%d program=%d\n",
+				  pid, program_number);
+			set_bit(pid, iec61883_4->pid_map);
+		}
+	}
+}
+
 static int mse_packetizer_iec61883_4_depacketize(int index,
 						 void *buffer,
 						 size_t buffer_size,
@@ -441,12 +492,13 @@ static int mse_packetizer_iec61883_4_depacketize(int index,
 	struct iec61883_4_packetizer *iec61883_4;
 	int payload_size;
 	int offset;
-	unsigned char *payload;
+	unsigned char *payload, *tsp;
+	int pid;
 
-	if (index >= ARRAY_SIZE(iec61883_4_packetizer_table))
+	iec61883_4 = mse_packetizer_idr_find(&iec61883_4_packetizer_idr, index);
+	if (!iec61883_4)
 		return -EPERM;
 
-	iec61883_4 = &iec61883_4_packetizer_table[index];
 	mse_debug("index=%d\n", index);
 
 	if (avtp_get_subtype(packet) != AVTP_SUBTYPE_61883_IIDC) {
@@ -484,8 +536,21 @@ static int mse_packetizer_iec61883_4_depacketize(int index,
 			  *(payload + offset + 1),
 			  *(payload + offset + 2),
 			  *(payload + offset + 3));
+		tsp = payload + offset;
+
+		/* drop TS packet not in allow-list, before copy */
+		if (iec61883_4->pid_filter_f) {
+			pid = ((tsp[1] & 0x1f) << 8) | tsp[2];
+			if (pid == TS_PID_PAT) {
+				iec61883_4_parse_pat(iec61883_4, tsp);
+			} else if (!test_bit(pid, iec61883_4->pid_map)) {
+				iec61883_4->stats.filtered_total++;
+				continue;
+			}
+		}
+
 		memcpy((unsigned char *)buffer + *buffer_processed,
-		       payload + offset, MSE_TS_PACKET_SIZE);
+		       tsp, MSE_TS_PACKET_SIZE);
 		*buffer_processed += MSE_TS_PACKET_SIZE;
 	}
 	*timestamp = avtp_get_timestamp(packet);
@@ -87,7 +87,6 @@ struct avtp_iec61883_6_param {
 };
 
 struct iec61883_6_packetizer {
-	bool used_f;
 	bool piece_f;
 
 	int send_seq_num;
@@ -110,14 +109,17 @@ struct iec61883_6_packetizer {
 	struct mse_packetizer_stats stats;
 };
 
-struct iec61883_6_packetizer iec61883_6_packetizer_table[MSE_INSTANCE_MAX];
+static DEFINE_IDR(iec61883_6_packetizer_idr);
 
 static int check_receive_packet(int index, int channels, int sample_rate)
 {
 	struct iec61883_6_packetizer *iec61883_6;
 	struct mse_audio_config *audio_config;
 
-	iec61883_6 = &iec61883_6_packetizer_table[index];
+	iec61883_6 = mse_packetizer_idr_find(&iec61883_6_packetizer_idr, index);
+	if (!iec61883_6)
+		return -EPERM;
+
 	audio_config = &iec61883_6->audio_config;
 
 	if (channels != audio_config->channels) {
@@ -143,10 +145,10 @@ static int check_packet_format(int index)
 	enum MSE_AUDIO_BIT sample_bit_depth;
 	int bytes_per_sample, bit_depth, sample_rate, channels;
 
-	if (index >= ARRAY_SIZE(iec61883_6_packetizer_table))
+	iec61883_6 = mse_packetizer_idr_find(&iec61883_6_packetizer_idr, index);
+	if (!iec61883_6)
 		return -EPERM;
 
-	iec61883_6 = &iec61883_6_packetizer_table[index];
 	audio_config = &iec61883_6->audio_config;
 
 	sample_bit_depth = audio_config->sample_bit_depth;
@@ -204,16 +206,12 @@ static int mse_packetizer_iec61883_6_open(void)
 	struct iec61883_6_packetizer *iec61883_6;
 	int index;
 
-	for (index = 0; iec61883_6_packetizer_table[index].used_f &&
-	     index < ARRAY_SIZE(iec61883_6_packetizer_table); index++)
-		;
-
-	if (index >= ARRAY_SIZE(iec61883_6_packetizer_table))
-		return -EPERM;
-
-	iec61883_6 = &iec61883_6_packetizer_table[index];
+	index = mse_packetizer_idr_alloc(&iec61883_6_packetizer_idr,
+					 sizeof(*iec61883_6),
+					 (void **)&iec61883_6);
+	if (index < 0)
+		return index;
 
-	iec61883_6->used_f = true;
 	iec61883_6->piece_f = false;
 	iec61883_6->send_seq_num = 0;
 	iec61883_6->local_total_samples = 0;
@@ -230,15 +228,15 @@ static int mse_packetizer_iec61883_6_release(int index)
 {
 	struct iec61883_6_packetizer *iec61883_6;
 
-	if (index >= ARRAY_SIZE(iec61883_6_packetizer_table))
+	iec61883_6 = mse_packetizer_idr_find(&iec61883_6_packetizer_idr, index);
+	if (!iec61883_6)
 		return -EPERM;
 
-	iec61883_6 = &iec61883_6_packetizer_table[index];
 	mse_debug("index=%d\n", index);
 
 	mse_packetizer_stats_report(&iec61883_6->stats);
 
-	memset(iec61883_6, 0, sizeof(*iec61883_6));
+	mse_packetizer_idr_free(&iec61883_6_packetizer_idr, index);
 
 	return 0;
 }
@@ -247,11 +245,10 @@ static int mse_packetizer_iec61883_6_packet_init(int index)
 {
 	struct iec61883_6_packetizer *iec61883_6;
 
-	if (index >= ARRAY_SIZE(iec61883_6_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
-	iec61883_6 = &iec61883_6_packetizer_table[index];
+	iec61883_6 = mse_packetizer_idr_find(&iec61883_6_packetizer_idr, index);
+	if (!iec61883_6)
+		return -EPERM;
 
 	iec61883_6->piece_f = false;
 	iec61883_6->send_seq_num = 0;
@@ -272,11 +269,11 @@ static int mse_packetizer_iec61883_6_set_network_config(
 {
 	struct iec61883_6_packetizer *iec61883_6;
 
-	if (index >= ARRAY_SIZE(iec61883_6_packetizer_table))
+	mse_debug("index=%d\n", index);
+	iec61883_6 = mse_packetizer_idr_find(&iec61883_6_packetizer_idr, index);
+	if (!iec61883_6)
 		return -EPERM;
 
-	mse_debug("index=%d\n", index);
-	iec61883_6 = &iec61883_6_packetizer_table[index];
 	iec61883_6->net_config = *config;
 
 	return 0;
@@ -332,13 +329,13 @@ static int mse_packetizer_iec61883_6_set_audio_config(
 	int payload_size;
 	int ret;
 
-	if (index >= ARRAY_SIZE(iec61883_6_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d rate=%d channels=%d samples_per_frame=%d\n",
 		  index, config->sample_rate, config->channels,
 		  config->samples_per_frame);
-	iec61883_6 = &iec61883_6_packetizer_table[index];
+	iec61883_6 = mse_packetizer_idr_find(&iec61883_6_packetizer_idr, index);
+	if (!iec61883_6)
+		return -EPERM;
+
 	iec61883_6->audio_config = *config;
 
 	ret = check_packet_format(index);
@@ -395,11 +392,10 @@ static int mse_packetizer_iec61883_6_get_audio_info(
 {
 	struct iec61883_6_packetizer *iec61883_6;
 
-	if (index >= ARRAY_SIZE(iec61883_6_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
-	iec61883_6 = &iec61883_6_packetizer_table[index];
+	iec61883_6 = mse_packetizer_idr_find(&iec61883_6_packetizer_idr, index);
+	if (!iec61883_6)
+		return -EPERM;
 
 	info->avtp_packet_size = iec61883_6->avtp_packet_size;
 	info->sample_per_packet = iec61883_6->sample_per_packet;
@@ -413,11 +409,10 @@ static int mse_packetizer_iec61883_6_calc_cbs(int index,
 {
 	struct iec61883_6_packetizer *iec61883_6;
 
-	if (index >= ARRAY_SIZE(iec61883_6_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
-	iec61883_6 = &iec61883_6_packetizer_table[index];
+	iec61883_6 = mse_packetizer_idr_find(&iec61883_6_packetizer_idr, index);
+	if (!iec61883_6)
+		return -EPERM;
 
 	return mse_packetizer_calc_cbs_by_frames(
 			iec61883_6->net_config.port_transmit_rate,
@@ -456,7 +451,10 @@ static int mse_packetizer_iec61883_6_set_payload(int index,
 		u32 *d32;
 	} data;
 
-	iec61883_6 = &iec61883_6_packetizer_table[index];
+	iec61883_6 = mse_packetizer_idr_find(&iec61883_6_packetizer_idr, index);
+	if (!iec61883_6)
+		return -EPERM;
+
 	data.d16 = (u16 *)(buffer + buffer_processed);
 	count = data_num / iec61883_6->audio_config.bytes_per_sample;
 
@@ -562,10 +560,10 @@ static int mse_packetizer_iec61883_6_packetize(int index,
 	u32 *sample;
 	int piece_size = 0, piece_len = 0;
 
-	if (index >= ARRAY_SIZE(iec61883_6_packetizer_table))
+	iec61883_6 = mse_packetizer_idr_find(&iec61883_6_packetizer_idr, index);
+	if (!iec61883_6)
 		return -EPERM;
 
-	iec61883_6 = &iec61883_6_packetizer_table[index];
 	mse_debug("index=%d seqnum=%d process=%zu/%zu t=%d\n",
 		  index, iec61883_6->send_seq_num, *buffer_processed,
 		  buffer_size, *timestamp);
@@ -659,17 +657,18 @@ static int get_am824_mbla_value(u32 *data, int *bit_depth)
 static int mse_packetizer_iec61883_6_data_convert(int index,
 						  int data_num,
 						  char *buf,
-						  void *packet)
+						  u32 *payload)
 {
-	u32 *payload;
 	struct iec61883_6_packetizer *iec61883_6;
 	struct mse_audio_config *audio_config;
 	int i;
 	int buf_bit_depth;
 
-	iec61883_6 = &iec61883_6_packetizer_table[index];
+	iec61883_6 = mse_packetizer_idr_find(&iec61883_6_packetizer_idr, index);
+	if (!iec61883_6)
+		return -EPERM;
+
 	audio_config = &iec61883_6->audio_config;
-	payload = packet + AVTP_IEC61883_6_PAYLOAD_OFFSET;
 	buf_bit_depth = mse_get_bit_depth(audio_config->sample_bit_depth);
 
 	for (i = 0; i < (data_num / audio_config->bytes_per_sample); i++) {
@@ -718,19 +717,19 @@ static int mse_packetizer_iec61883_6_depacketize(int index,
 						 size_t packet_size)
 {
 	struct iec61883_6_packetizer *iec61883_6;
-	int payload_size, piece_size = 0;
+	int payload_size;
 	u32 offset;
+	u32 *payload;
 	int channels;
 	int sample_rate;
-	int data_size;
-	char *buf, tmp_buffer[ETHFRAMEMTU_MAX] = {0};
+	int data_size, in_size, piece_size, head;
+	int bytes_per_sample;
 	int ret;
 
-	if (index >= ARRAY_SIZE(iec61883_6_packetizer_table))
-		return -EPERM;
-
 	mse_debug("index=%d\n", index);
-	iec61883_6 = &iec61883_6_packetizer_table[index];
+	iec61883_6 = mse_packetizer_idr_find(&iec61883_6_packetizer_idr, index);
+	if (!iec61883_6)
+		return -EPERM;
 
 	if (avtp_get_subtype(packet) != AVTP_SUBTYPE_61883_IIDC) {
 		mse_err("error subtype=%d\n", avtp_get_subtype(packet));
@@ -786,32 +785,44 @@ static int mse_packetizer_iec61883_6_depacketize(int index,
 		*buffer_processed += offset;
 	}
 
-	/* buffer over check */
-	if (*buffer_processed + data_size > buffer_size)
-		buf = tmp_buffer;
-	else
-		buf = buffer + *buffer_processed;
-
 	/* seq_num check */
 	mse_packetizer_stats_seqnum(&iec61883_6->stats,
 				    avtp_get_sequence_num(packet));
 
+	/* samples fit in buffer are converted into it directly */
+	bytes_per_sample = iec61883_6->audio_config.bytes_per_sample;
+	payload = packet + AVTP_IEC61883_6_PAYLOAD_OFFSET;
+	in_size = min_t(size_t, data_size, buffer_size - *buffer_processed);
+	in_size -= in_size % bytes_per_sample;
+
 	mse_packetizer_iec61883_6_data_convert(index,
-					       data_size - piece_size,
-					       buf,
-					       packet);
+					       in_size,
+					       buffer + *buffer_processed,
+					       payload);
+	*buffer_processed += in_size;
+
+	/* buffer over, rest samples are kept for next buffer */
+	if (in_size < data_size) {
+		piece_size = data_size - in_size;
+		mse_packetizer_iec61883_6_data_convert(
+			index,
+			piece_size,
+			iec61883_6->packet_piece,
+			payload + in_size / bytes_per_sample);
+
+		/* head of the sample straddling the end of buffer */
+		head = buffer_size - *buffer_processed;
+		if (head) {
+			memcpy(buffer + *buffer_processed,
+			       iec61883_6->packet_piece, head);
+			memmove(iec61883_6->packet_piece,
+				iec61883_6->packet_piece + head,
+				piece_size - head);
+		}
 
-	if (*buffer_processed + data_size > buffer_size) {
 		iec61883_6->piece_f = true;
-		piece_size = buffer_size - *buffer_processed;
-		iec61883_6->piece_data_len = data_size - piece_size;
-		memcpy(buffer + *buffer_processed, buf, piece_size);
-		memcpy(iec61883_6->packet_piece, buf + piece_size,
-		       iec61883_6->piece_data_len);
-
-		*buffer_processed += (buffer_size - *buffer_processed);
-	} else {
-		*buffer_processed += data_size;
+		iec61883_6->piece_data_len = piece_size - head;
+		*buffer_processed = buffer_size;
 	}
 
 	*timestamp = avtp_get_timestamp(packet);
@@ -828,10 +839,10 @@ int mse_packetizer_iec61883_6_set_start_time(int index,
 {
 	struct iec61883_6_packetizer *iec61883_6;
 
-	if (index >= ARRAY_SIZE(iec61883_6_packetizer_table))
+	iec61883_6 = mse_packetizer_idr_find(&iec61883_6_packetizer_idr, index);
+	if (!iec61883_6)
 		return -EPERM;
 
-	iec61883_6 = &iec61883_6_packetizer_table[index];
 	iec61883_6->start_time = *start_time;
 
 	return 0;
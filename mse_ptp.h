@@ -79,6 +79,8 @@ int mse_ptp_get_timestamps_dummy(void *ptp_handle,
 				 int req_count,
 				 u64 *timestamps);
 
+struct mse_ptp_capture_ring *mse_ptp_capture_ring_get_dummy(void *ptp_handle);
+
 void *mse_ptp_timer_open_dummy(u32 (*handler)(void *),
 			       void *priv);
 
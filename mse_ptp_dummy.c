@@ -67,6 +67,8 @@
 #include <linux/slab.h>
 #include <linux/time.h>
 #include <linux/hrtimer.h>
+#include <linux/log2.h>
+#include <linux/random.h>
 
 #include "ravb_mse_kernel.h"
 
@@ -75,24 +77,24 @@
 
 #define PTP_DUMMY_INTERVAL 3333333  /* 3.33..ms */
 
-#define q_next(que, pos)        (((que)->pos + 1) % (que)->len)
-#define q_empty(que)            ((que)->head == (que)->tail)
+#define PTP_DUMMY_DRIFT_MAX     1000000     /* ppb (1000ppm) */
+#define PTP_DUMMY_JITTER_MAX    1000000     /* ns (1ms) */
+#define PTP_DUMMY_LOSS_SCALE    1000        /* per mille */
 
 /* structs */
-struct ptp_queue {
-	int head;
-	int tail;
-	int len;
-	u64 *timestamps;
-};
-
 struct ptp_device {
 	int			index;
 	int			ch;
 	struct			hrtimer timer;
 	int			timer_interval;
-	struct ptp_queue	que;
-	/* timestamp queue lock */
+	/* simulated capture edge */
+	u64			capture_base;
+	u64			capture_count;
+	/* timestamp ring, shared with capture ring consumers */
+	struct mse_ptp_capture_ring ring;
+	/* read position of get_timestamps */
+	u32			read_pos;
+	/* timestamp ring read lock */
 	spinlock_t		qlock;
 };
 
@@ -101,35 +103,78 @@ static struct ptp_device *g_ptp_devices[MAX_PTP_DEVICES];
 DECLARE_BITMAP(ptp_dummy_device_map, MAX_PTP_DEVICES);
 DEFINE_SPINLOCK(ptp_dummy_lock);
 
-static int enqueue(struct ptp_queue *que, u64 ns)
+/*
+ * module parameters for simulating capture signal impairments,
+ * read on every capture tick, so changes apply to running capture
+ * at once. Drift is taken from capture start, a change steps time.
+ */
+static int ptp_dummy_drift_ppb;
+module_param(ptp_dummy_drift_ppb, int, 0644);
+MODULE_PARM_DESC(ptp_dummy_drift_ppb,
+		 "Frequency offset of dummy capture signal in ppb");
+
+static int ptp_dummy_jitter_ns;
+module_param(ptp_dummy_jitter_ns, int, 0644);
+MODULE_PARM_DESC(ptp_dummy_jitter_ns,
+		 "Peak jitter of dummy capture timestamps in ns");
+
+static int ptp_dummy_loss_permille;
+module_param(ptp_dummy_loss_permille, int, 0644);
+MODULE_PARM_DESC(ptp_dummy_loss_permille,
+		 "Probability of dummy capture loss in per mille");
+
+static void ring_put(struct mse_ptp_capture_ring *ring, u64 ns)
 {
-	mse_debug("START head=%d, tail=%d\n", que->head, que->tail);
-
-	if (q_next(que, tail) == que->head)
-		que->head = q_next(que, head);
+	u32 head = ring->head;
 
-	que->timestamps[que->tail] = ns;
-	que->tail = q_next(que, tail);
+	ring->timestamps[head & (ring->size - 1)] = ns;
 
-	return 0;
+	/* publish entry to consumers */
+	smp_store_release(&ring->head, head + 1);
 }
 
-static int dequeue(struct ptp_queue *que, u64 *ns)
+static u64 ptp_dummy_capture_time(struct ptp_device *dev)
 {
-	if (q_empty(que))
-		return -1;
+	s64 elapsed, drift, jitter;
+	s32 rem;
+	int drift_ppb, jitter_ns;
 
-	*ns = que->timestamps[que->head];
-	que->head = q_next(que, head);
+	drift_ppb = clamp(ptp_dummy_drift_ppb,
+			  -PTP_DUMMY_DRIFT_MAX, PTP_DUMMY_DRIFT_MAX);
+	jitter_ns = clamp(ptp_dummy_jitter_ns, 0, PTP_DUMMY_JITTER_MAX);
 
-	return 0;
+	dev->capture_count++;
+
+	/* no impairment, use system time as is */
+	if (!drift_ppb && !jitter_ns)
+		return ktime_get_real_ns();
+
+	/* ideal edge time of the drifted capture signal */
+	elapsed = (s64)dev->capture_count * dev->timer_interval;
+	drift = div_s64_rem(elapsed, NSEC_PER_SEC, &rem) * drift_ppb;
+	drift += div_s64((s64)rem * drift_ppb, NSEC_PER_SEC);
+
+	jitter = 0;
+	if (jitter_ns)
+		jitter = (s64)(prandom_u32() % (2 * jitter_ns + 1)) -
+			 jitter_ns;
+
+	return dev->capture_base + elapsed + drift + jitter;
+}
+
+static bool ptp_dummy_capture_lost(void)
+{
+	if (ptp_dummy_loss_permille <= 0)
+		return false;
+
+	return (prandom_u32() % PTP_DUMMY_LOSS_SCALE) <
+		ptp_dummy_loss_permille;
 }
 
 static enum hrtimer_restart ptp_timestamp_callback(struct hrtimer *arg)
 {
 	struct ptp_device *dev;
 	u64 ns;
-	unsigned long flags;
 
 	dev = container_of(arg, struct ptp_device, timer);
 
@@ -138,15 +183,15 @@ static enum hrtimer_restart ptp_timestamp_callback(struct hrtimer *arg)
 
 	hrtimer_add_expires_ns(&dev->timer, dev->timer_interval);
 
-	/* Get time from system timer */
-	ns = ktime_get_real_ns();
+	/* Get time from system timer, with simulated impairments */
+	ns = ptp_dummy_capture_time(dev);
 
-	spin_lock_irqsave(&dev->qlock, flags);
+	/* simulate missing capture event */
+	if (ptp_dummy_capture_lost())
+		return HRTIMER_RESTART;
 
-	/* add to queue */
-	enqueue(&dev->que, ns);
-
-	spin_unlock_irqrestore(&dev->qlock, flags);
+	/* add to ring */
+	ring_put(&dev->ring, ns);
 
 	return HRTIMER_RESTART;
 }
@@ -192,9 +237,9 @@ int mse_ptp_capture_stop_dummy(void *ptp_handle)
 	hrtimer_cancel(&dev->timer);
 
 	/* unassing and free timestamp buffer */
-	kfree(dev->que.timestamps);
-	dev->que.timestamps = NULL;
-	dev->que.len = 0;
+	kfree(dev->ring.timestamps);
+	dev->ring.timestamps = NULL;
+	dev->ring.size = 0;
 
 	return 0;
 }
@@ -205,6 +250,7 @@ int mse_ptp_capture_start_dummy(void *ptp_handle,
 {
 	struct ptp_device *dev;
 	void *timestamps;
+	u32 size;
 	int ret;
 
 	dev = mse_ptp_get_dev(ptp_handle);
@@ -212,7 +258,8 @@ int mse_ptp_capture_start_dummy(void *ptp_handle,
 		return -EINVAL;
 
 	/* alloc timestamp buffer */
-	timestamps = kcalloc(max_count + 1, sizeof(u64), GFP_KERNEL);
+	size = roundup_pow_of_two(max_count + 1);
+	timestamps = kcalloc(size, sizeof(u64), GFP_KERNEL);
 	if (!timestamps)
 		return -ENOMEM;
 
@@ -225,11 +272,15 @@ int mse_ptp_capture_start_dummy(void *ptp_handle,
 		}
 	}
 
-	/* assign timestamp buffer to queue */
-	dev->que.timestamps = timestamps;
-	dev->que.len = max_count + 1;
+	/* assign timestamp buffer to ring */
+	dev->ring.timestamps = timestamps;
+	dev->ring.size = size;
+	dev->ring.head = 0;
+	dev->read_pos = 0;
 
 	/* start timer */
+	dev->capture_base = ktime_get_real_ns();
+	dev->capture_count = 0;
 	dev->timer_interval = PTP_DUMMY_INTERVAL;
 	hrtimer_start(&dev->timer,
 		      ns_to_ktime(dev->timer_interval),
@@ -243,7 +294,9 @@ int mse_ptp_get_timestamps_dummy(void *ptp_handle,
 				 u64 *timestamps)
 {
 	struct ptp_device *dev;
+	struct mse_ptp_capture_ring *ring;
 	unsigned long flags;
+	u32 head;
 	int i;
 
 	dev = mse_ptp_get_dev(ptp_handle);
@@ -254,17 +307,42 @@ int mse_ptp_get_timestamps_dummy(void *ptp_handle,
 	if (!dev->timer_interval)
 		return -EPERM;
 
+	ring = &dev->ring;
+
 	spin_lock_irqsave(&dev->qlock, flags);
 
-	for (i = 0; i < req_count; i++)
-		if (dequeue(&dev->que, &timestamps[i]) < 0)
-			break;
+	head = smp_load_acquire(&ring->head);
+
+	/* overflowed, skip to oldest valid entry */
+	if (head - dev->read_pos > ring->size - 1)
+		dev->read_pos = head - (ring->size - 1);
+
+	for (i = 0; i < req_count && dev->read_pos != head; i++) {
+		timestamps[i] = ring->timestamps[dev->read_pos &
+						 (ring->size - 1)];
+		dev->read_pos++;
+	}
 
 	spin_unlock_irqrestore(&dev->qlock, flags);
 
 	return i;
 }
 
+struct mse_ptp_capture_ring *mse_ptp_capture_ring_get_dummy(void *ptp_handle)
+{
+	struct ptp_device *dev;
+
+	dev = mse_ptp_get_dev(ptp_handle);
+	if (!dev)
+		return NULL;
+
+	/* if timer is NOT started */
+	if (!dev->timer_interval)
+		return NULL;
+
+	return &dev->ring;
+}
+
 void *mse_ptp_open_dummy(void)
 {
 	int index;
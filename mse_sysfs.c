@@ -102,6 +102,7 @@
 #define MSE_NAME_LEN_MAX         (32)
 #define MSE_MAC_STR_LEN_MAX      (12)
 #define MSE_STREAMID_STR_LEN_MAX (16)
+#define MSE_PID_FILTER_STR_LEN_MAX (128)
 
 #define MSE_SYSFS_NAME_STR_MODULE_NAME               "module_name"
 #define MSE_SYSFS_NAME_STR_DEVICE_NAME_TX            "device_name_tx"
@@ -1031,6 +1032,80 @@ static ssize_t mse_mpeg2ts_config_u32_store(struct device *dev,
 	return len;
 }
 
+static ssize_t mse_mpeg2ts_config_pid_filter_show(
+					struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	struct mse_media_mpeg2ts_pid_filter data;
+	int index = mse_dev_to_index(dev);
+	int ret, i;
+	ssize_t len = 0;
+
+	mse_debug("START %s\n", attr->attr.name);
+
+	ret = mse_config_get_media_mpeg2ts_pid_filter(index, &data);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < data.num; i++)
+		len += sprintf(buf + len, "%s%u", i ? " " : "", data.pid[i]);
+
+	len += sprintf(buf + len, "\n");
+
+	mse_debug("END value=%s ret=%zd\n", buf, len);
+
+	return len;
+}
+
+static ssize_t mse_mpeg2ts_config_pid_filter_store(
+					struct device *dev,
+					struct device_attribute *attr,
+					const char *buf,
+					size_t len)
+{
+	struct mse_media_mpeg2ts_pid_filter data;
+	int index = mse_dev_to_index(dev);
+	char buf2[MSE_PID_FILTER_STR_LEN_MAX + 1];
+	char *cur, *token;
+	int ret;
+	u32 value;
+
+	mse_debug("START %s(%zd) to %s\n", buf, len, attr->attr.name);
+
+	if (len > sizeof(buf2))
+		return -EINVAL;
+
+	/* PID list separated by space or comma, empty list disables filter */
+	ret = mse_sysfs_strncpy_from_user(buf2, buf, sizeof(buf2));
+	if (ret < 0)
+		return ret;
+
+	memset(&data, 0, sizeof(data));
+	cur = buf2;
+	while ((token = strsep(&cur, " ,")) != NULL) {
+		if (!*token)
+			continue;
+
+		if (data.num >= MSE_CONFIG_PID_FILTER_MAX)
+			return -EINVAL;
+
+		ret = kstrtou32(token, 0, &value);
+		if (ret)
+			return -EINVAL;
+
+		data.pid[data.num++] = value;
+	}
+
+	ret = mse_config_set_media_mpeg2ts_pid_filter(index, &data);
+	if (ret)
+		return ret;
+
+	mse_debug("END num=%u ret=%zd\n", data.num, len);
+
+	return len;
+}
+
 static ssize_t mse_ptp_config_type_show(struct device *dev,
 					struct device_attribute *attr,
 					char *buf)
@@ -1769,11 +1844,13 @@ static MSE_DEVICE_ATTR(bitrate, mpeg2ts_config, 0644,
 static MSE_DEVICE_ATTR(pcr_pid, mpeg2ts_config, 0644,
 		       mse_mpeg2ts_config_u32_show,
 		       mse_mpeg2ts_config_u32_store);
+static MSE_DEVICE_ATTR_RW(pid_filter, mpeg2ts_config);
 
 static struct attribute *mse_attr_mpeg2ts_config[] = {
 	&mse_dev_attr_mpeg2ts_config_tspackets_per_frame.attr,
 	&mse_dev_attr_mpeg2ts_config_bitrate.attr,
 	&mse_dev_attr_mpeg2ts_config_pcr_pid.attr,
+	&mse_dev_attr_mpeg2ts_config_pid_filter.attr,
 	NULL,
 };
 
@@ -65,7 +65,7 @@
 /**
  * @brief MSE's media adapter max
  */
-#define MSE_ADAPTER_MEDIA_MAX   (10)
+#define MSE_ADAPTER_MEDIA_MAX   (64)
 
 /**
  * @brief MSE's network adapter max
@@ -75,7 +75,7 @@
 /**
  * @brief MSE's instance max
  */
-#define MSE_INSTANCE_MAX        (10)
+#define MSE_INSTANCE_MAX        (64)
 
 /**
  * @brief Resistered adapter name length
@@ -87,6 +87,12 @@
  */
 #define MSE_MAC_LEN_MAX		(6)
 
+/**
+ * @brief V4L2 control of video output (V4L2_CID_USER_BASE + 0x1000),
+ *        while set, queued buffers carry a part of frame
+ */
+#define MSE_V4L2_CID_PARTIAL_FRAME (0x00980900 + 0x1000)
+
 enum MSE_STREAM_TYPE {
 	MSE_STREAM_TYPE_AUDIO,
 	MSE_STREAM_TYPE_VIDEO,
@@ -141,6 +147,23 @@ struct mse_avtp_rx_param {
 	uint8_t streamid[8];
 };
 
+#define MSE_CONFIG_FANOUT_MAX   (3)
+
+/* empty device_name_tx means the device of the main stream */
+struct mse_avtp_tx_fanout_dest {
+	uint8_t                  device_name_tx[32];
+	struct mse_avtp_tx_param param;
+};
+
+/*
+ * additional destinations sending the packets of the main stream,
+ * needs a network adapter copying packets on send (netdev)
+ */
+struct mse_avtp_tx_fanout {
+	uint32_t                      num;
+	struct mse_avtp_tx_fanout_dest dest[MSE_CONFIG_FANOUT_MAX];
+};
+
 #define MSE_CONFIG_SAMPLE_PER_FRAME_MAX (738)
 
 enum MSE_CRF_TYPE {
@@ -178,6 +201,14 @@ struct mse_media_mpeg2ts_config {
 	uint32_t pcr_pid;
 };
 
+#define MSE_CONFIG_PID_FILTER_MAX         (16)
+
+/* num = 0 means all PIDs are passed, PAT and PMT are always passed */
+struct mse_media_mpeg2ts_pid_filter {
+	uint32_t num;
+	uint32_t pid[MSE_CONFIG_PID_FILTER_MAX];
+};
+
 enum MSE_PTP_TYPE {
 	MSE_PTP_TYPE_CURRENT_TIME,
 	MSE_PTP_TYPE_CAPTURE,
@@ -243,5 +274,11 @@ struct mse_delay_time {
 #define MSE_G_AVTP_RX_PARAM_CRF _IOR(MSE_MAGIC, 23, struct mse_avtp_rx_param)
 #define MSE_S_DELAY_TIME        _IOW(MSE_MAGIC, 24, struct mse_delay_time)
 #define MSE_G_DELAY_TIME        _IOR(MSE_MAGIC, 25, struct mse_delay_time)
+#define MSE_S_MEDIA_MPEG2TS_PID_FILTER \
+			_IOW(MSE_MAGIC, 26, struct mse_media_mpeg2ts_pid_filter)
+#define MSE_G_MEDIA_MPEG2TS_PID_FILTER \
+			_IOR(MSE_MAGIC, 27, struct mse_media_mpeg2ts_pid_filter)
+#define MSE_S_AVTP_TX_FANOUT    _IOW(MSE_MAGIC, 28, struct mse_avtp_tx_fanout)
+#define MSE_G_AVTP_TX_FANOUT    _IOR(MSE_MAGIC, 29, struct mse_avtp_tx_fanout)
 
 #endif /* __RAVB_MSE_H__ */
@@ -91,6 +91,11 @@
  */
 #define MSE_INDEX_UNDEFINED	(-1)
 
+/**
+ * @brief Max periods submitted by one mse_start_transmission_periods()
+ */
+#define MSE_TRANS_PERIODS_MAX	(8)
+
 /**
  * @brief Check Type of MSE
  */
@@ -163,6 +168,8 @@ struct mse_audio_config {
 	bool is_big_endian;
 	/** @brief samples per frame */
 	int samples_per_frame;
+	/** @brief timestamps per CRF AVTPDU, 0 is default */
+	int crf_timestamps_per_pdu;
 	/* if need, add more parameters */
 };
 
@@ -210,6 +217,10 @@ struct mse_mpeg2ts_config {
 	int pcr_pid;
 	/** @brief mpeg2ts type */
 	enum MSE_MPEG2TS_TYPE mpeg2ts_type;
+	/** @brief number of PIDs to pass on receive, 0 is all */
+	int pid_filter_num;
+	/** @brief PIDs to pass on receive, PAT and PMT are always passed */
+	int pid_filter[MSE_CONFIG_PID_FILTER_MAX];
 };
 
 /**
@@ -222,6 +233,8 @@ struct mse_packet {
 	dma_addr_t paddr;
 	/** @brief virtual address for driver */
 	void *vaddr;
+	/** @brief launch time as gPTP time [ns], 0 is send immediately */
+	u64 launch_time;
 };
 
 /**
@@ -243,6 +256,8 @@ struct mse_adapter_network_ops {
 	char *name;
 	/** @brief type */
 	enum MSE_TYPE type;
+	/** @brief send copies packets, they can be rewritten on return */
+	bool f_send_copy;
 	/** @brief open function pointer */
 	int (*open)(char *name);
 	/** @brief release function pointer */
@@ -269,6 +284,8 @@ struct mse_adapter_network_ops {
 	int (*cancel)(int index);
 	/** @brief get link speed function pointer */
 	int (*get_link_speed)(int index);
+	/** @brief enable launch time function pointer (optional) */
+	int (*set_launch_time)(int index, bool enable);
 };
 
 /**
@@ -285,6 +302,23 @@ struct mch_ops {
 				  int *value);
 };
 
+/**
+ * @brief capture timestamps ring shared between PTP driver and MSE
+ *
+ * PTP driver writes timestamps[head & (size - 1)] and then advances
+ * head with smp_store_release(). MSE keeps its own read position and
+ * consumes timestamps in bulk without copying them through the ops.
+ * Oldest entries are overwritten when MSE does not keep up.
+ */
+struct mse_ptp_capture_ring {
+	/** @brief number of timestamps entries, must be power of 2 */
+	u32 size;
+	/** @brief free running write position */
+	u32 head;
+	/** @brief timestamps entries */
+	u64 *timestamps;
+};
+
 /**
  * @brief registered operations for external ptp
  */
@@ -298,6 +332,8 @@ struct mse_ptp_ops {
 	int (*capture_start)(void *ptp_handle, int ch, int max_count);
 	int (*capture_stop)(void *ptp_handle);
 	int (*get_timestamps)(void *ptp_handle, int req_count, u64 *timestamps);
+	/* optional, return NULL if capture ring is not supported */
+	struct mse_ptp_capture_ring *(*capture_ring_get)(void *ptp_handle);
 
 	/* PTP Timer API */
 	void *(*timer_open)(u32 (*handler)(void *), void *priv);
@@ -477,6 +513,80 @@ int mse_start_transmission(int index,
 			   void *priv,
 			   int (*mse_completion)(void *priv, int size));
 
+/**
+ * @brief start transmission of a part of frame
+ *
+ * Parts of one frame share the AVTP timestamp of its first part, and
+ * the frame end is signaled only on the last part.
+ *
+ * @param[in] index MSE instance ID
+ * @param[in] buffer send data
+ * @param[in] buffer_size buffer size
+ * @param[in] frame_end buffer is the last part of frame
+ * @param[out] priv private data
+ * @param[in] mse_completion callback function pointer
+ *
+ * @retval 0 Success
+ * @retval <0 Error
+ */
+int mse_start_transmission_frame(int index,
+				 void *buffer,
+				 size_t buffer_size,
+				 bool frame_end,
+				 void *priv,
+				 int (*mse_completion)(void *priv, int size));
+
+/**
+ * @brief start transmission of contiguous periods
+ *
+ * Each period is completed separately by mse_completion.
+ *
+ * @param[in] index MSE instance ID
+ * @param[in] buffer top of first period
+ * @param[in] period_size period size
+ * @param[in] periods number of periods, up to MSE_TRANS_PERIODS_MAX
+ * @param[out] priv private data
+ * @param[in] mse_completion callback function pointer
+ *
+ * @retval 0 Success
+ * @retval <0 Error
+ */
+int mse_start_transmission_periods(int index,
+				   void *buffer,
+				   size_t period_size,
+				   int periods,
+				   void *priv,
+				   int (*mse_completion)(void *priv,
+							 int size));
+
+/**
+ * @brief check whether the buffer being completed ends a frame
+ *
+ * Valid in mse_completion of a receive instance. A video buffer
+ * completed before picture end by low latency delivery returns false.
+ *
+ * @param[in] index MSE instance ID
+ *
+ * @retval true buffer ends a frame
+ * @retval false buffer carries a part of frame
+ */
+bool mse_is_frame_end(int index);
+
+/**
+ * @brief set number of buffers media adapter can have queued at most
+ *
+ * MSE holds MPEG2-TS buffers until their PCR, and releases them when
+ * the adapter cannot queue another one. Default is the number of
+ * buffers accepted by mse_start_transmission().
+ *
+ * @param[in] index MSE instance ID
+ * @param[in] depth number of buffers
+ *
+ * @retval 0 Success
+ * @retval <0 Error
+ */
+int mse_set_trans_depth(int index, int depth);
+
 /**
  * @brief register MCH to MSE
  *